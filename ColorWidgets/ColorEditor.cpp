@@ -1,977 +1,4536 @@
 #include "ColorEditor.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <limits>
+#include <mutex>
 #include <queue>
+#include <vector>
 
 #include <QApplication>
-#include <QCheckBox>
+#include <QComboBox>
 #include <QCursor>
 #include <QDebug>
 #include <QDesktopWidget>
 #include <QDialogButtonBox>
 #include <QDrag>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
 #include <QGridLayout>
 #include <QGroupBox>
+#include <QHash>
 #include <QHBoxLayout>
 #include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMimeData>
 #include <QMouseEvent>
+#include <QMutex>
 #include <QPainter>
+#include <QPixmap>
 #include <QPushButton>
+#include <QRunnable>
 #include <QScreen>
 #include <QScrollBar>
+#include <QSemaphore>
 #include <QSettings>
 #include <QSpinBox>
 #include <QSplitter>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVarLengthArray>
 #include <QVBoxLayout>
+#include <QWaitCondition>
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+#include <QColorSpace>
+#include <QColorTransform>
+#endif
 
 int DPI(int x)
 {
     return QGuiApplication::primaryScreen()->logicalDotsPerInch() * x / 96;
 }
 
-//------------------------------------------- color correction -----------------------------------------------
-void ColorCorrection::correct(QColor& color)
+// rendered once and shared, a translucent swatch is one extra textured fill
+static const QBrush& checkerboard()
 {
-    double r = color.redF();
-    double g = color.greenF();
-    double b = color.blueF();
-    color.setRedF(std::pow(r, 1 / gamma));
-    color.setGreenF(std::pow(g, 1 / gamma));
-    color.setBlueF(std::pow(b, 1 / gamma));
+    static const QBrush brush = []() {
+        const int cell = DPI(4);
+        QPixmap tile(cell * 2, cell * 2);
+        tile.fill(Qt::white);
+        QPainter painter(&tile);
+        painter.fillRect(0, 0, cell, cell, QColor(204, 204, 204));
+        painter.fillRect(cell, cell, cell, cell, QColor(204, 204, 204));
+        return QBrush(tile);
+    }();
+    return brush;
 }
 
-void ColorCorrection::correct(QImage& image)
+// color composited over the checkerboard, opaque colors are a single fill
+static void fillSwatch(QPainter& painter, const QRect& rect, const QColor& color)
 {
-    for (int x = 0; x < image.width(); ++x) {
-        for (int y = 0; y < image.height(); ++y) {
-            QColor color = image.pixelColor(x, y);
-            correct(color);
-            image.setPixelColor(x, y, color);
-        }
+    if (color.alpha() < 255) {
+        painter.fillRect(rect, checkerboard());
     }
+    painter.fillRect(rect, color);
 }
 
-//--------------------------------------------------------- color wheel ------------------------------------------------
-class ColorWheel::Private
+// drag image of a swatch, drawn like the swatch itself
+static QPixmap swatchPixmap(const QSize& size, const QColor& color)
 {
-public:
-    static constexpr int selectorRadius = 4;
-    static constexpr int comboSelectorRadius = 3;
-    int radius = 0;
-    QColor selectedColor = QColor(Qt::white);
-    QImage colorBuffer;
-    colorcombo::ICombination* colorCombination = nullptr;
-    ColorCorrection* colorCorrection = nullptr;
+    QPixmap pix(size);
+    QPainter painter(&pix);
+    fillSwatch(painter, pix.rect(), color);
+    return pix;
+}
 
-    void renderWheel(const QRect& rect)
-    {
-        auto center = rect.center();
-        auto size = rect.size();
+//------------------------------------------- color correction -----------------------------------------------
+namespace
+{
+// transfer functions, linear light to display encoded value
+template<TransferKind K>
+struct Transfer;
 
-        radius = std::min(rect.width(), rect.height()) / 2 - selectorRadius;
+template<>
+struct Transfer<TransferKind::Linear>
+{
+    static double encode(double x) { return x; }
+    static double decode(double x) { return x; }
+};
 
-        // init buffer
-        colorBuffer = QImage(size, QImage::Format_ARGB32);
-        colorBuffer.fill(Qt::transparent);
+template<>
+struct Transfer<TransferKind::SRGB>
+{
+    static double encode(double x) { return x <= 0.0031308 ? 12.92 * x : 1.055 * std::pow(x, 1 / 2.4) - 0.055; }
+    static double decode(double x) { return x <= 0.04045 ? x / 12.92 : std::pow((x + 0.055) / 1.055, 2.4); }
+};
 
-        // create gradient
-        QConicalGradient hsvGradient(center, 0);
-        for (int deg = 0; deg < 360; deg += 60) {
-            hsvGradient.setColorAt(deg / 360.0, QColor::fromHsvF(deg / 360.0, 1.0, selectedColor.valueF()));
-        }
-        hsvGradient.setColorAt(1.0, QColor::fromHsvF(0.0, 1.0, selectedColor.valueF()));
+template<>
+struct Transfer<TransferKind::Gamma>
+{
+    static double encode(double x) { return std::pow(x, 1 / 2.2); }
+    static double decode(double x) { return std::pow(x, 2.2); }
+};
 
-        QRadialGradient valueGradient(center, radius);
-        valueGradient.setColorAt(0.0, QColor::fromHsvF(0.0, 0.0, selectedColor.valueF()));
-        valueGradient.setColorAt(1.0, Qt::transparent);
+template<>
+struct Transfer<TransferKind::BT1886>
+{
+    // L = a * max(V + b, 0) ^ 2.4, with Lw = 1 and Lb = 0 it is a pure 2.4 power curve
+    static double encode(double x) { return std::pow(x, 1 / 2.4); }
+    static double decode(double x) { return std::pow(x, 2.4); }
+};
 
-        QPainter painter(&colorBuffer);
-        painter.setRenderHint(QPainter::Antialiasing, true);
-        // draw color wheel
-        painter.setPen(Qt::transparent);
-        painter.setBrush(hsvGradient);
-        painter.drawEllipse(center, radius, radius);
-        painter.setBrush(valueGradient);
-        painter.drawEllipse(center, radius, radius);
+template<>
+struct Transfer<TransferKind::PQ>
+{
+    static constexpr double m1 = 2610.0 / 16384;
+    static constexpr double m2 = 2523.0 / 4096 * 128;
+    static constexpr double c1 = 3424.0 / 4096;
+    static constexpr double c2 = 2413.0 / 4096 * 32;
+    static constexpr double c3 = 2392.0 / 4096 * 32;
 
-        // color correction
-        if (colorCorrection) {
-            colorCorrection->correct(colorBuffer);
-        }
+    static double encode(double x)
+    {
+        double y = std::pow(std::max(x, 0.0), m1);
+        return std::pow((c1 + c2 * y) / (1 + c3 * y), m2);
+    }
+    static double decode(double x)
+    {
+        double n = std::pow(std::max(x, 0.0), 1 / m2);
+        return std::pow(std::max(n - c1, 0.0) / (c2 - c3 * n), 1 / m1);
     }
 };
 
-ColorWheel::ColorWheel(QWidget* parent)
-    : QWidget(parent)
-    , p(new Private)
+template<>
+struct Transfer<TransferKind::HLG>
 {
-    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
-}
+    static constexpr double a = 0.17883277;
+    static constexpr double b = 0.28466892; // 1 - 4a
+    static constexpr double c = 0.55991073; // 0.5 - a * ln(4a)
 
-ColorWheel::~ColorWheel() = default;
+    static double encode(double x) { return x <= 1.0 / 12 ? std::sqrt(3 * std::max(x, 0.0)) : a * std::log(12 * x - b) + c; }
+    static double decode(double x) { return x <= 0.5 ? x * x / 3 : (std::exp((x - c) / a) + b) / 12; }
+};
 
-void ColorWheel::setColorCombination(colorcombo::ICombination* combination)
+quint64 nextVersion()
 {
-    p->colorCombination = combination;
-    repaint();
+    static std::atomic<quint64> version(0);
+    return ++version;
 }
 
-void ColorWheel::setSelectedColor(const QColor& color)
+// dither thresholds in 1/256 of an 8 bit step, one tile wrapped over the image
+constexpr int ditherSize = 64;
+
+struct DitherTile
 {
-    if (!isEnabled()) return;
+    int thresholds[ditherSize * ditherSize];
 
-    if (color.value() != p->selectedColor.value()) {
-        p->selectedColor = color;
-        p->renderWheel(this->rect());
-    }
-    else {
-        p->selectedColor = color;
-    }
-    update();
-}
+    const int* row(int y) const { return thresholds + (y & (ditherSize - 1)) * ditherSize; }
+};
 
-void ColorWheel::setColorCorrection(ColorCorrection* colorCorrection)
+// bayer matrix of size n repeated over the tile, the lowest coordinate bits are the highest rank bits
+DitherTile bayerTile(int n)
 {
-    p->colorCorrection = colorCorrection;
-    p->renderWheel(this->rect());
-    update();
-}
+    int levels = 0;
+    while ((1 << levels) < n) ++levels;
 
-QColor ColorWheel::getSelectedColor() const
-{
-    return p->selectedColor;
+    DitherTile tile;
+    for (int y = 0; y < ditherSize; ++y) {
+        for (int x = 0; x < ditherSize; ++x) {
+            int rank = 0;
+            for (int i = 0; i < levels; ++i) {
+                int level = ((((x ^ y) >> i) & 1) << 1) | ((y >> i) & 1);
+                rank |= level << (2 * (levels - 1 - i));
+            }
+            tile.thresholds[y * ditherSize + x] = (2 * rank + 1) * 128 / (n * n);
+        }
+    }
+    return tile;
 }
 
-QColor ColorWheel::getColor(int x, int y) const
+// void and cluster (Ulichney 1993), gaussian energy with sigma 1.5 on the torus
+DitherTile blueNoiseTile()
 {
-    if (p->radius <= 0) return QColor();
+    constexpr int n = ditherSize;
+    constexpr int count = n * n;
+    constexpr int mask = n - 1;
 
-    auto line = QLineF(this->rect().center(), QPointF(x, y));
-    auto h = line.angle() / 360.0;
-    auto s = std::min(1.0, line.length() / p->radius);
-    auto v = p->selectedColor.valueF();
-    return QColor::fromHsvF(h, s, v);
-}
+    std::vector<float> kernel(count);
+    for (int y = 0; y < n; ++y) {
+        for (int x = 0; x < n; ++x) {
+            int dx = std::min(x, n - x), dy = std::min(y, n - y);
+            kernel[y * n + x] = std::exp(-(dx * dx + dy * dy) / (2 * 1.5f * 1.5f));
+        }
+    }
 
-void ColorWheel::paintEvent(QPaintEvent* e)
-{
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing, true);
-    // draw wheel
-    painter.drawImage(0, 0, p->colorBuffer);
-    // draw selected color circle
-    painter.setPen(Qt::black);
-    painter.setBrush(Qt::white);
-    drawSelector(&painter, p->selectedColor, p->selectorRadius);
-    // draw color combination circle
-    if (p->colorCombination) {
-        auto colors = p->colorCombination->genColors(p->selectedColor);
-        for (const auto& color : colors) {
-            drawSelector(&painter, color, p->comboSelectorRadius);
+    std::vector<char> bits(count, 0);
+    std::vector<float> energy(count, 0.0f);
+    auto toggle = [&](int index, bool on) {
+        const int iy = index / n, ix = index % n;
+        const float sign = on ? 1.0f : -1.0f;
+        bits[index] = on;
+        for (int y = 0; y < n; ++y) {
+            const float* k = kernel.data() + ((y - iy) & mask) * n;
+            float* e = energy.data() + y * n;
+            for (int x = 0; x < n; ++x) {
+                e[x] += sign * k[(x - ix) & mask];
+            }
+        }
+    };
+    // highest energy of the set pixels, lowest of the empty ones
+    auto tightestCluster = [&]() {
+        int best = -1;
+        for (int i = 0; i < count; ++i) {
+            if (bits[i] && (best < 0 || energy[i] > energy[best])) best = i;
+        }
+        return best;
+    };
+    auto largestVoid = [&]() {
+        int best = -1;
+        for (int i = 0; i < count; ++i) {
+            if (!bits[i] && (best < 0 || energy[i] < energy[best])) best = i;
+        }
+        return best;
+    };
+
+    // a tenth of the pixels from a fixed seed, the tile is the same on every run
+    const int initial = count / 10;
+    quint32 state = 0x9e3779b9u;
+    for (int placed = 0; placed < initial;) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        const int index = state % count;
+        if (!bits[index]) {
+            toggle(index, true);
+            ++placed;
         }
-        // add selected color, so the user can switch between this
-        colors.push_back(p->selectedColor);
-        emit combinationColorChanged(colors);
     }
-}
+    // move pixels from the tightest cluster to the largest void until that is the same pixel
+    for (int i = 0; i < count; ++i) {
+        const int cluster = tightestCluster();
+        toggle(cluster, false);
+        const int hole = largestVoid();
+        toggle(hole, true);
+        if (hole == cluster) break;
+    }
 
-void ColorWheel::mousePressEvent(QMouseEvent* e)
-{
-    processMouseEvent(e);
-}
+    std::vector<int> rank(count);
+    const std::vector<char> prototype = bits;
+    const std::vector<float> prototypeEnergy = energy;
+    for (int r = initial - 1; r >= 0; --r) {
+        const int cluster = tightestCluster();
+        toggle(cluster, false);
+        rank[cluster] = r;
+    }
+    // past half the tightest cluster of empty pixels is the lowest energy of the set ones, so one rule fills both phases
+    bits = prototype;
+    energy = prototypeEnergy;
+    for (int r = initial; r < count; ++r) {
+        const int hole = largestVoid();
+        toggle(hole, true);
+        rank[hole] = r;
+    }
 
-void ColorWheel::mouseMoveEvent(QMouseEvent* e)
-{
-    processMouseEvent(e);
+    DitherTile tile;
+    for (int i = 0; i < count; ++i) {
+        tile.thresholds[i] = (2 * rank[i] + 1) * 128 / count;
+    }
+    return tile;
 }
 
-void ColorWheel::resizeEvent(QResizeEvent* e)
+// tile of a dither mode, fallback for Dither::None
+const DitherTile* ditherTile(Dither dither, const DitherTile* fallback = nullptr)
 {
-    p->renderWheel(this->rect());
+    switch (dither) {
+    case Dither::Ordered: {
+        static const DitherTile tile = bayerTile(8);
+        return &tile;
+    }
+    case Dither::BlueNoise: {
+        static const DitherTile tile = blueNoiseTile();
+        return &tile;
+    }
+    default:
+        return fallback;
+    }
 }
+} // namespace
 
-void ColorWheel::processMouseEvent(QMouseEvent* e)
+// lookup tables of a transfer function, built once per kind
+struct ColorCorrection::Table
 {
-    if (e->buttons() & Qt::LeftButton) {
-        p->selectedColor = getColor(e->x(), e->y());
-        emit colorSelected(p->selectedColor);
-        update();
+    double (*encode)(double);
+    double (*decode)(double);
+    uchar encode8[256];
+    // 8 bit encode with 8 bits fraction, at most 255 * 256 so adding a dither threshold never overflows,
+    // 8 bit linear input is already quantized, so this only keeps codes from merging where the curve is flat
+    quint16 encode8Fine[256];
+    float decode8[256];
+    // 16 bit encode, sampled every 16 input codes and interpolated
+    quint16 encode16[4097];
+
+    Table(double (*encodeFunc)(double), double (*decodeFunc)(double))
+        : encode(encodeFunc)
+        , decode(decodeFunc)
+    {
+        for (int i = 0; i < 256; ++i) {
+            encode8[i] = static_cast<uchar>(qBound(0.0, std::round(encode(i / 255.0) * 255), 255.0));
+            encode8Fine[i] = static_cast<quint16>(qBound(0.0, std::round(encode(i / 255.0) * 255 * 256), 255.0 * 256));
+            decode8[i] = static_cast<float>(decode(i / 255.0));
+        }
+        for (int i = 0; i <= 4096; ++i) {
+            encode16[i] = static_cast<quint16>(qBound(0.0, std::round(encode(std::min(1.0, i / 4096.0)) * 65535), 65535.0));
+        }
     }
-}
 
-void ColorWheel::drawSelector(QPainter* painter, const QColor& color, int radius)
-{
-    auto line = QLineF::fromPolar(color.hsvSaturationF() * p->radius, color.hsvHueF() * 360.0);
-    line.translate(this->rect().center());
-    painter->drawEllipse(line.p2(), radius, radius);
-}
+    int encodeTo16(int v) const
+    {
+        int index = v >> 4;
+        int frac = v & 15;
+        return (encode16[index] * (16 - frac) + encode16[index + 1] * frac) >> 4;
+    }
 
-//-------------------------------------------------- color combination --------------------------------------------
-namespace colorcombo
-{
-ICombination::ICombination(QObject* parent)
-    : QObject(parent)
-    , m_min(0)
-    , m_max(1)
-    , m_value(0)
-    , m_decimals(0)
-    , m_rangeEnabled(false)
-{
-}
+    // every 16 bit input to 8 bit with 8 bits fraction, one lookup and add per channel with a dither threshold,
+    // 128 KB per kind, so it is built on first use
+    const quint16* encode16Fine() const
+    {
+        std::call_once(fineOnce, [this]() {
+            fine.resize(65536);
+            for (int i = 0; i < 65536; ++i) {
+                fine[i] = static_cast<quint16>(qBound(0.0, std::round(encode(i / 65535.0) * 255 * 256), 255.0 * 256));
+            }
+        });
+        return fine.data();
+    }
+    mutable std::once_flag fineOnce;
+    mutable std::vector<quint16> fine;
 
-ICombination::ICombination(double min, double max, double value, int decimals, bool rangeEnabled, QObject* parent)
-    : QObject(parent)
-    , m_min(min)
-    , m_max(max)
-    , m_value(value)
-    , m_decimals(decimals)
-    , m_rangeEnabled(rangeEnabled)
-{
-}
+    template<TransferKind K>
+    static const Table* get()
+    {
+        static const Table table(&Transfer<K>::encode, &Transfer<K>::decode);
+        return &table;
+    }
+};
 
-QString ICombination::name()
+// 3d lut of a color transform, trilinear interpolated for whole images
+struct ColorCorrection::Lut3D
 {
-    return tr("None");
-}
+    static constexpr int size = 33;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    QColorTransform transform;
+#endif
+    // 16 bit display values, 3 per grid point
+    QVector<quint16> table;
+    // grid position of an 8 bit linear input, 8 bits fraction
+    int position8[256];
+    // encodes 16 bit linear input to its grid position
+    const Table* srgb = Table::get<TransferKind::SRGB>();
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    // the grid is spaced evenly on srgb encoded input, linear spacing would put ~50 output codes in its first step
+    explicit Lut3D(const QColorTransform& colorTransform)
+        : transform(colorTransform)
+        , table(size * size * size * 3)
+    {
+        auto gridValue = [](int i) { return qRound(Transfer<TransferKind::SRGB>::decode(i / double(size - 1)) * 65535); };
+        for (int r = 0; r < size; ++r) {
+            for (int g = 0; g < size; ++g) {
+                for (int b = 0; b < size; ++b) {
+                    const QRgba64 mapped = transform.map(QRgba64::fromRgba64(gridValue(r), gridValue(g), gridValue(b), 65535));
+                    quint16* entry = table.data() + ((r * size + g) * size + b) * 3;
+                    entry[0] = mapped.red();
+                    entry[1] = mapped.green();
+                    entry[2] = mapped.blue();
+                }
+            }
+        }
+        for (int v = 0; v < 256; ++v) {
+            position8[v] = qRound(Transfer<TransferKind::SRGB>::encode(v / 255.0) * (size - 1) * 256);
+        }
+    }
+#endif
 
-QVector<QColor> ICombination::genColors(const QColor& color)
-{
-    return {};
-}
+    // d is the dither threshold of the output in 1/256 of a step, 128 rounds
+    QRgb map(QRgb pixel, int d = 128) const
+    {
+        return lookup(position8[qRed(pixel)], position8[qGreen(pixel)], position8[qBlue(pixel)], qAlpha(pixel), d);
+    }
 
-void ICombination::setRange(double min, double max)
-{
-    m_min = min;
-    m_max = max;
-}
+    // 16 bit linear input, the bits below 8 bit stay in the grid position instead of being dithered away
+    QRgb map16(int r, int g, int b, int alpha, int d) const
+    {
+        auto position = [this](int v) { return srgb->encodeTo16(v) * (size - 1) * 256 / 65535; };
+        return lookup(position(r), position(g), position(b), alpha, d);
+    }
 
-void ICombination::setValue(double value)
-{
-    m_value = value;
-}
+    // grid positions with 8 bits fraction to an 8 bit pixel
+    QRgb lookup(int rp, int gp, int bp, int alpha, int d) const
+    {
+        auto split = [](int pos, int& index, int& frac) {
+            index = qMin(pos >> 8, size - 2);
+            frac = pos - (index << 8);
+        };
+        int ri, rf, gi, gf, bi, bf;
+        split(rp, ri, rf);
+        split(gp, gi, gf);
+        split(bp, bi, bf);
+
+        const quint16* c = table.constData() + ((ri * size + gi) * size + bi) * 3;
+        const int db = 3;
+        const int dg = size * 3;
+        const int dr = size * size * 3;
+        int out[3];
+        for (int ch = 0; ch < 3; ++ch) {
+            auto at = [&](int offset) { return int(c[offset + ch]); };
+            int c00 = (at(0) * (256 - bf) + at(db) * bf) >> 8;
+            int c01 = (at(dg) * (256 - bf) + at(dg + db) * bf) >> 8;
+            int c10 = (at(dr) * (256 - bf) + at(dr + db) * bf) >> 8;
+            int c11 = (at(dr + dg) * (256 - bf) + at(dr + dg + db) * bf) >> 8;
+            int c0 = (c00 * (256 - gf) + c01 * gf) >> 8;
+            int c1 = (c10 * (256 - gf) + c11 * gf) >> 8;
+            // 16 bit with 8 bits fraction, to 8 bit plus the threshold
+            out[ch] = std::min(255, ((c0 * (256 - rf) + c1 * rf) / 257 + d) >> 8);
+        }
+        return qRgba(out[0], out[1], out[2], alpha);
+    }
+};
 
-void ICombination::setDecimals(int decimals)
+// color vision deficiency as a linear rgb matrix, premultiplied into per channel tables for 8 bit input
+struct ColorCorrection::Simulation
+{
+    VisionDeficiency deficiency;
+    float severity;
+    float matrix[9];
+    // display encoded input is decoded with this first, nullptr for linear input
+    const float* decode8;
+    // 8 bit input to 16 bit linear output, one pixel is 9 lookups and 6 adds
+    int tables[9][256];
+
+    Simulation(VisionDeficiency visionDeficiency, float simulationSeverity, const float* decodeTable)
+        : deficiency(visionDeficiency)
+        , severity(simulationSeverity)
+        , decode8(decodeTable)
+    {
+        // Machado et al. 2009 at full severity, Achromatopsia keeps the luminance
+        static const float full[4][9] = {
+            {0.152286f, 1.052583f, -0.204868f, 0.114503f, 0.786281f, 0.099216f, -0.003882f, -0.048116f, 1.051998f},
+            {0.367322f, 0.860646f, -0.227968f, 0.280085f, 0.672501f, 0.047413f, -0.011820f, 0.042940f, 0.968881f},
+            {1.255528f, -0.076749f, -0.178779f, -0.078411f, 0.930809f, 0.147602f, 0.004733f, 0.691367f, 0.303900f},
+            {0.2126f, 0.7152f, 0.0722f, 0.2126f, 0.7152f, 0.0722f, 0.2126f, 0.7152f, 0.0722f}};
+        const float* m = full[static_cast<int>(deficiency) - 1];
+        for (int i = 0; i < 9; ++i) {
+            float identity = i % 4 == 0 ? 1.0f : 0.0f;
+            matrix[i] = identity + (m[i] - identity) * severity;
+        }
+        for (int v = 0; v < 256; ++v) {
+            float linear = decode8 ? decode8[v] : v / 255.0f;
+            for (int i = 0; i < 9; ++i) {
+                tables[i][v] = qRound(matrix[i] * linear * 65535);
+            }
+        }
+    }
+
+    // 16 bit input to 16 bit linear output
+    void apply16(int& r, int& g, int& b) const
+    {
+        auto linear = [this](int v) {
+            if (!decode8) return v / 65535.0f;
+            int index = v >> 8;
+            float frac = (v & 255) / 256.0f;
+            return decode8[index] + (decode8[std::min(index + 1, 255)] - decode8[index]) * frac;
+        };
+        float lr = linear(r), lg = linear(g), lb = linear(b);
+        auto out = [](float v) { return qBound(0, qRound(v * 65535), 65535); };
+        r = out(matrix[0] * lr + matrix[1] * lg + matrix[2] * lb);
+        g = out(matrix[3] * lr + matrix[4] * lg + matrix[5] * lb);
+        b = out(matrix[6] * lr + matrix[7] * lg + matrix[8] * lb);
+    }
+};
+
+// 16 bit value to 8 bit with 8 bits fraction, plus dither threshold
+static inline int quantize(int v16, int d)
 {
-    m_decimals = decimals;
+    return std::min(255, (v16 * 256 / 257 + d) >> 8);
 }
 
-double ICombination::min() const
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+static QByteArray colorSpaceKey(const QColorSpace& colorSpace)
 {
-    return m_min;
+    QByteArray icc = colorSpace.iccProfile();
+    if (!icc.isEmpty()) return icc;
+    return QByteArray::number(int(colorSpace.primaries())) + '/' + QByteArray::number(int(colorSpace.transferFunction())) + '/' +
+           QByteArray::number(colorSpace.gamma());
 }
+#endif
 
-double ICombination::max() const
+ColorCorrection::ColorCorrection(TransferKind kind, RenderPrecision precision, const Table* table, Dither dither)
+    : m_kind(kind)
+    , m_precision(precision)
+    , m_table(table)
+    , m_dither(dither)
+    , m_version(nextVersion())
 {
-    return m_max;
 }
 
-double ICombination::getValue() const
+ColorCorrectionPtr ColorCorrection::create(TransferKind kind, RenderPrecision precision, Dither dither)
 {
-    return m_value;
+    static const Table* tables[] = {Table::get<TransferKind::Linear>(), Table::get<TransferKind::SRGB>(),
+                                    Table::get<TransferKind::Gamma>(),  Table::get<TransferKind::BT1886>(),
+                                    Table::get<TransferKind::PQ>(),     Table::get<TransferKind::HLG>()};
+    // shared per kind, precision and dither, so buffers keyed by version can be reused across widgets and editors
+    static QMutex mutex;
+    static ColorCorrectionPtr profiles[3][2][6];
+
+    QMutexLocker locker(&mutex);
+    auto& profile = profiles[static_cast<int>(dither)][static_cast<int>(precision)][static_cast<int>(kind)];
+    if (!profile) {
+        profile = ColorCorrectionPtr(new ColorCorrection(kind, precision, tables[static_cast<int>(kind)], dither));
+    }
+    return profile;
 }
 
-bool ICombination::rangeEnabled() const
+ColorCorrectionPtr ColorCorrection::fromIccProfile(const QString& fileName, RenderPrecision precision)
 {
-    return m_rangeEnabled;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "ColorCorrection::fromIccProfile: can't open" << fileName;
+        return nullptr;
+    }
+    QColorSpace display = QColorSpace::fromIccProfile(file.readAll());
+    if (!display.isValid()) {
+        qWarning() << "ColorCorrection::fromIccProfile: invalid icc profile" << fileName;
+        return nullptr;
+    }
+
+    // one lut per (source, destination) pair, shared by every profile and buffer using it
+    static QMutex mutex;
+    static QHash<QByteArray, std::shared_ptr<const Lut3D>> luts;
+    const QColorSpace source(QColorSpace::SRgbLinear);
+    const QByteArray key = colorSpaceKey(source) + '\0' + colorSpaceKey(display);
+    std::shared_ptr<const Lut3D> lut;
+    {
+        QMutexLocker locker(&mutex);
+        lut = luts.value(key);
+        if (!lut) {
+            lut = std::make_shared<const Lut3D>(source.transformationToColorSpace(display));
+            luts.insert(key, lut);
+        }
+    }
+
+    auto correction = new ColorCorrection(TransferKind::SRGB, precision, Table::get<TransferKind::SRGB>());
+    correction->m_lut = lut;
+    correction->m_iccFileName = fileName;
+    return ColorCorrectionPtr(correction);
+#else
+    qWarning() << "ColorCorrection::fromIccProfile: icc profile needs Qt 5.14";
+    return nullptr;
+#endif
 }
 
-int ICombination::decimals() const
+ColorCorrectionPtr ColorCorrection::withSimulation(const ColorCorrectionPtr& base, VisionDeficiency deficiency, float severity)
 {
-    return m_decimals;
+    if (!base) return base;
+
+    severity = qBound(0.0f, severity, 1.0f);
+    const bool simulate = deficiency != VisionDeficiency::None && severity > 0;
+    if (!simulate && !base->m_simulation) return base;
+    if (!simulate && !base->m_lut) return create(base->m_kind, base->m_precision, base->m_dither);
+
+    // without correction the input is display encoded, it is simulated in linear srgb and encoded back
+    const bool displayInput = !base->m_lut && base->m_kind == TransferKind::Linear;
+    const Table* table = base->m_lut || displayInput ? Table::get<TransferKind::SRGB>() : create(base->m_kind, base->m_precision)->m_table;
+    auto correction = new ColorCorrection(base->m_kind, base->m_precision, table, base->m_dither);
+    correction->m_lut = base->m_lut;
+    correction->m_iccFileName = base->m_iccFileName;
+    if (simulate) {
+        correction->m_simulation = std::make_shared<const Simulation>(deficiency, severity, displayInput ? table->decode8 : nullptr);
+    }
+    return ColorCorrectionPtr(correction);
 }
 
-Complementary::Complementary(QObject* parent)
-    : ICombination(parent)
+ColorCorrectionPtr ColorCorrection::withDither(const ColorCorrectionPtr& base, Dither dither)
 {
+    if (!base || base->m_dither == dither) return base;
+    if (!base->m_lut && !base->m_simulation) return create(base->m_kind, base->m_precision, dither);
+
+    auto correction = new ColorCorrection(base->m_kind, base->m_precision, base->m_table, dither);
+    correction->m_lut = base->m_lut;
+    correction->m_simulation = base->m_simulation;
+    correction->m_iccFileName = base->m_iccFileName;
+    return ColorCorrectionPtr(correction);
 }
 
-QString Complementary::name()
+TransferKind ColorCorrection::kind() const
 {
-    return tr("Complementary");
+    return m_kind;
 }
 
-QVector<QColor> Complementary::genColors(const QColor& color)
+RenderPrecision ColorCorrection::precision() const
 {
-    return {QColor::fromHsv((color.hsvHue() + 180) % 360, color.hsvSaturation(), color.value())};
+    return m_precision;
 }
 
-Monochromatic::Monochromatic(QObject* parent)
-    : ICombination(0, 1, 0.5, 4, true, parent)
+QImage::Format ColorCorrection::renderFormat() const
 {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+    if (m_precision == RenderPrecision::Int16) return QImage::Format_RGBA64;
+#endif
+    return QImage::Format_ARGB32;
 }
 
-QString Monochromatic::name()
+bool ColorCorrection::isIccProfile() const
 {
-    return tr("Monochromatic");
+    return m_lut != nullptr;
 }
 
-QVector<QColor> Monochromatic::genColors(const QColor& color)
+QString ColorCorrection::iccFileName() const
 {
-    double rate = getValue() / (max() - min());
-    return {QColor::fromHsvF(color.hsvHueF(), color.hsvSaturationF(), color.valueF() * rate)};
+    return m_iccFileName;
 }
 
-Analogous::Analogous(QObject* parent)
-    : ICombination(0, 180, 30, 0, true, parent)
+VisionDeficiency ColorCorrection::deficiency() const
 {
+    return m_simulation ? m_simulation->deficiency : VisionDeficiency::None;
 }
 
-QString Analogous::name()
+float ColorCorrection::severity() const
 {
-    return tr("Analogous");
+    return m_simulation ? m_simulation->severity : 0.0f;
 }
 
-QVector<QColor> Analogous::genColors(const QColor& color)
+Dither ColorCorrection::dither() const
 {
-    int add = getValue();
-    return {QColor::fromHsv((color.hsvHue() + add) % 360, color.hsvSaturation(), color.value()),
-            QColor::fromHsv((color.hsvHue() - add + 360) % 360, color.hsvSaturation(), color.value())};
+    return m_dither;
 }
 
-Triadic::Triadic(QObject* parent)
-    : ICombination(0, 180, 120, 0, true, parent)
+quint64 ColorCorrection::version() const
 {
+    return m_version;
 }
 
-QString Triadic::name()
+quint64 ColorCorrection::versionOf(const ColorCorrectionPtr& colorCorrection)
 {
-    return tr("Triadic");
+    // 0 means no correction
+    return colorCorrection ? colorCorrection->version() : 0;
 }
 
-QVector<QColor> Triadic::genColors(const QColor& color)
+float ColorCorrection::encode(float linear) const
 {
-    int add = getValue();
-    return {QColor::fromHsv((color.hsvHue() + add) % 360, color.hsvSaturation(), color.value()),
-            QColor::fromHsv((color.hsvHue() - add + 360) % 360, color.hsvSaturation(), color.value())};
+    return static_cast<float>(m_table->encode(linear));
 }
 
-Tetradic::Tetradic(QObject* parent)
-    : ICombination(-90, 90, 90, 0, true, parent)
+float ColorCorrection::decode(float encoded) const
 {
+    return static_cast<float>(m_table->decode(encoded));
 }
 
-QString Tetradic::name()
+void ColorCorrection::correct(QColor& color) const
 {
-    return tr("Tetradic");
+    if (m_simulation) {
+        const Simulation& s = *m_simulation;
+        auto linear = [&s](qreal v) { return s.decode8 ? Transfer<TransferKind::SRGB>::decode(v) : v; };
+        qreal r = linear(color.redF()), g = linear(color.greenF()), b = linear(color.blueF());
+        color.setRedF(qBound(0.0, s.matrix[0] * r + s.matrix[1] * g + s.matrix[2] * b, 1.0));
+        color.setGreenF(qBound(0.0, s.matrix[3] * r + s.matrix[4] * g + s.matrix[5] * b, 1.0));
+        color.setBlueF(qBound(0.0, s.matrix[6] * r + s.matrix[7] * g + s.matrix[8] * b, 1.0));
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+    if (m_lut) {
+        QColor mapped = m_lut->transform.map(color).toRgb();
+        mapped.setAlphaF(color.alphaF());
+        color = mapped;
+        return;
+    }
+#endif
+    color.setRedF(qBound(0.0, m_table->encode(color.redF()), 1.0));
+    color.setGreenF(qBound(0.0, m_table->encode(color.greenF()), 1.0));
+    color.setBlueF(qBound(0.0, m_table->encode(color.blueF()), 1.0));
 }
 
-QVector<QColor> Tetradic::genColors(const QColor& color)
+void ColorCorrection::correct(QImage& image) const
 {
-    /*
-     * A--------B
-     * |        |
-     * D--------C
-     *
-     * A : H, S, V
-     * B : H - 90 + factor * 180, S, V
-     * C : H + 180, S, V
-     * D : H + 90 + factor * 180, S, V
-     */
-    int add = getValue();
-    return {QColor::fromHsv((color.hsvHue() + add + 360) % 360, color.hsvSaturation(), color.value()),
-            QColor::fromHsv((color.hsvHue() + 180) % 360, color.hsvSaturation(), color.value()),
-            QColor::fromHsv((color.hsvHue() + add + 180 + 360) % 360, color.hsvSaturation(), color.value())};
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+    if (image.format() == QImage::Format_RGBA64) {
+        image = correct16(image);
+        return;
+    }
+#endif
+    const QImage::Format format = image.format();
+    if (format != QImage::Format_ARGB32 && format != QImage::Format_RGB32) {
+        image = image.convertToFormat(QImage::Format_ARGB32);
+    }
+
+    const int width = image.width();
+    // the dither threshold replaces the rounding of the last quantization, bayer of size 1 is plain rounding
+    static const DitherTile rounding = bayerTile(1);
+    const DitherTile* tile = ditherTile(m_dither, &rounding);
+    const int mask = ditherSize - 1;
+    if (m_simulation) {
+        // simulation and encoding fused in one pass, 16 bit linear in between
+        const Simulation& s = *m_simulation;
+        auto channel = [&s](int row, QRgb pixel) {
+            return qBound(0, s.tables[row][qRed(pixel)] + s.tables[row + 1][qGreen(pixel)] + s.tables[row + 2][qBlue(pixel)], 65535);
+        };
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const int* threshold = tile->row(y);
+            for (int x = 0; x < width; ++x) {
+                const QRgb pixel = line[x];
+                const int d = threshold[x & mask];
+                const int r = channel(0, pixel), g = channel(3, pixel), b = channel(6, pixel);
+                line[x] = m_lut ? m_lut->map16(r, g, b, qAlpha(pixel), d)
+                                : qRgba(quantize(m_table->encodeTo16(r), d), quantize(m_table->encodeTo16(g), d),
+                                        quantize(m_table->encodeTo16(b), d), qAlpha(pixel));
+            }
+        }
+    }
+    else if (m_lut) {
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const int* threshold = tile->row(y);
+            for (int x = 0; x < width; ++x) {
+                line[x] = m_lut->map(line[x], threshold[x & mask]);
+            }
+        }
+    }
+    else if (m_dither != Dither::None) {
+        // still one lookup per channel, the threshold replaces the rounding of the 8 bit encode
+        const quint16* table = m_table->encode8Fine;
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const int* threshold = tile->row(y);
+            for (int x = 0; x < width; ++x) {
+                const QRgb pixel = line[x];
+                const int d = threshold[x & mask];
+                line[x] = qRgba((table[qRed(pixel)] + d) >> 8, (table[qGreen(pixel)] + d) >> 8, (table[qBlue(pixel)] + d) >> 8, qAlpha(pixel));
+            }
+        }
+    }
+    else {
+        // one table lookup per channel, no branch in the loop
+        const uchar* table = m_table->encode8;
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < width; ++x) {
+                const QRgb pixel = line[x];
+                line[x] = qRgba(table[qRed(pixel)], table[qGreen(pixel)], table[qBlue(pixel)], qAlpha(pixel));
+            }
+        }
+    }
+
+    if (image.format() != format) {
+        image = image.convertToFormat(format);
+    }
 }
-} // namespace colorcombo
 
-//--------------------------------------------------- color slider -------------------------------------------
-MixedSpinBox::MixedSpinBox(QWidget* parent)
-    : QDoubleSpinBox(parent)
-{
-    setObjectName("MixedSpinBox");
-    setDecimals(4);
-    setSingleStep(0.0001);
-    setFocusPolicy(Qt::ClickFocus);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+QImage ColorCorrection::correct16(const QImage& image) const
+{
+    // 4x4 bayer unless another dither is chosen
+    static const DitherTile bayer = bayerTile(4);
+    const DitherTile* tile = ditherTile(m_dither, &bayer);
+    const int mask = ditherSize - 1;
+
+    // encode in 16 bit, then the only quantization to 8 bit happens here with dither
+    const quint16* table = m_table->encode16Fine();
+    QImage result(image.size(), QImage::Format_ARGB32);
+    const int width = image.width();
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgba64* src = reinterpret_cast<const QRgba64*>(image.constScanLine(y));
+        QRgb* dst = reinterpret_cast<QRgb*>(result.scanLine(y));
+        const int* threshold = tile->row(y);
+        if (m_simulation) {
+            for (int x = 0; x < width; ++x) {
+                const QRgba64 pixel = src[x];
+                const int d = threshold[x & mask];
+                int r = pixel.red(), g = pixel.green(), b = pixel.blue();
+                m_simulation->apply16(r, g, b);
+                dst[x] = m_lut ? m_lut->map16(r, g, b, pixel.alpha8(), d)
+                               : qRgba(quantize(m_table->encodeTo16(r), d), quantize(m_table->encodeTo16(g), d),
+                                       quantize(m_table->encodeTo16(b), d), pixel.alpha8());
+            }
+        }
+        else if (m_lut) {
+            // interpolated from the 16 bit input, only the lut output is dithered
+            for (int x = 0; x < width; ++x) {
+                const QRgba64 pixel = src[x];
+                dst[x] = m_lut->map16(pixel.red(), pixel.green(), pixel.blue(), pixel.alpha8(), threshold[x & mask]);
+            }
+        }
+        else {
+            for (int x = 0; x < width; ++x) {
+                const QRgba64 pixel = src[x];
+                const int d = threshold[x & mask];
+                dst[x] = qRgba((table[pixel.red()] + d) >> 8, (table[pixel.green()] + d) >> 8, (table[pixel.blue()] + d) >> 8, pixel.alpha8());
+            }
+        }
+    }
+    return result;
 }
+#endif
 
-QString MixedSpinBox::textFromValue(double value) const
+//------------------------------------------------------ color value ------------------------------------------------
+ColorValue::ColorValue()
+    : m_r(1.0f)
+    , m_g(1.0f)
+    , m_b(1.0f)
+    , m_h(0.0f)
+    , m_s(0.0f)
+    , m_v(1.0f)
+    , m_sl(0.0f)
+    , m_l(1.0f)
+    , m_a(1.0f)
 {
-    QString shortestNum = QLocale().toString(value, 'f', QLocale::FloatingPointShortest);
-    QString decimalNum = QLocale().toString(value, 'f', decimals());
-    return shortestNum.size() <= decimalNum.size() ? shortestNum : decimalNum;
 }
 
-void MixedSpinBox::keyPressEvent(QKeyEvent* e)
+ColorValue::ColorValue(const QColor& color, const ColorValue& previous)
+    : ColorValue(previous)
 {
-    if (e->key() == Qt::Key_Return || e->key() == Qt::Key_Enter) {
-        clearFocus();
+    if (!color.isValid()) return;
+
+    if (color.spec() == QColor::Hsv) {
+        *this = fromHsvF(color.hsvHueF() < 0 ? m_h : color.hsvHueF(), color.hsvSaturationF(), color.valueF(), previous);
+    }
+    else if (color.spec() == QColor::Hsl) {
+        *this = fromHslF(color.hslHueF() < 0 ? m_h : color.hslHueF(), color.hslSaturationF(), color.lightnessF(), previous);
     }
     else {
-        QDoubleSpinBox::keyPressEvent(e);
+        *this = fromRgbF(color.redF(), color.greenF(), color.blueF(), previous);
     }
+    m_a = color.alphaF();
 }
 
-class JumpableSlider::Private
+ColorValue ColorValue::fromRgbF(float r, float g, float b, const ColorValue& previous)
 {
-public:
-    double minValue = 0.0;
-    double maxValue = 1.0;
-    double singleStep = 0.0001;
-};
+    ColorValue value(previous);
+    value.m_r = qBound(0.0f, r, 1.0f);
+    value.m_g = qBound(0.0f, g, 1.0f);
+    value.m_b = qBound(0.0f, b, 1.0f);
+    value.updateFromRgb();
+    return value;
+}
 
-JumpableSlider::JumpableSlider(QWidget* parent)
-    : JumpableSlider(Qt::Horizontal, parent)
+ColorValue ColorValue::fromHsvF(float h, float s, float v, const ColorValue& previous)
 {
+    ColorValue value(previous);
+    value.m_h = qBound(0.0f, h, 1.0f);
+    value.m_s = qBound(0.0f, s, 1.0f);
+    value.m_v = qBound(0.0f, v, 1.0f);
+    value.updateFromHsv();
+    return value;
 }
 
-JumpableSlider::JumpableSlider(Qt::Orientation orientation, QWidget* parent)
-    : QSlider(orientation, parent)
-    , p(new Private)
+ColorValue ColorValue::fromHslF(float h, float s, float l, const ColorValue& previous)
 {
-    connect(this, &QSlider::valueChanged, this, [this](int value) { emit valueChanged(value * p->singleStep); });
+    ColorValue value(previous);
+    value.m_h = qBound(0.0f, h, 1.0f);
+    value.m_sl = qBound(0.0f, s, 1.0f);
+    value.m_l = qBound(0.0f, l, 1.0f);
+    value.updateFromHsl();
+    return value;
 }
 
-JumpableSlider::~JumpableSlider() = default;
+ColorValue ColorValue::fromAlphaF(float a, const ColorValue& previous)
+{
+    ColorValue value(previous);
+    value.m_a = qBound(0.0f, a, 1.0f);
+    return value;
+}
 
-void JumpableSlider::setValue(double value)
+QColor ColorValue::toColor() const
 {
-    // need round
-    // 0.179999 * 1000 need be 180
-    // int(0.179999 * 1000) = 179
-    QSlider::setValue(std::round(value / p->singleStep));
+    return QColor::fromRgbF(m_r, m_g, m_b, m_a);
 }
 
-void JumpableSlider::setMinimum(double value)
+float ColorValue::redF() const
 {
-    QSlider::setMinimum(value / p->singleStep);
-    p->minValue = value;
+    return m_r;
 }
 
-void JumpableSlider::setMaximum(double value)
+float ColorValue::greenF() const
 {
-    if (value < p->minValue) {
-        return;
-    }
-    QSlider::setMaximum(value / p->singleStep);
-    p->maxValue = value;
+    return m_g;
 }
 
-void JumpableSlider::setRange(double minValue, double maxValue)
+float ColorValue::blueF() const
 {
-    setMinimum(minValue);
-    setMaximum(maxValue);
+    return m_b;
 }
 
-void JumpableSlider::setSingleStep(double value)
+float ColorValue::hueF() const
 {
-    if (value == 0.0) {
-        return;
-    }
-    p->singleStep = value;
-    setMinimum(p->minValue);
-    setMaximum(p->maxValue);
-    setValue(this->value());
+    return m_h;
 }
 
-double JumpableSlider::value() const
+float ColorValue::saturationF() const
 {
-    return QSlider::value() * p->singleStep;
+    return m_s;
 }
 
-double JumpableSlider::minimum() const
+float ColorValue::valueF() const
 {
-    return p->minValue;
+    return m_v;
 }
 
-double JumpableSlider::maximum() const
+float ColorValue::hslSaturationF() const
 {
-    return p->maxValue;
+    return m_sl;
 }
 
-double JumpableSlider::singleStep() const
+float ColorValue::lightnessF() const
 {
-    return p->singleStep;
+    return m_l;
 }
 
-void JumpableSlider::mousePressEvent(QMouseEvent* e)
+float ColorValue::alphaF() const
 {
-    if (e->button() == Qt::LeftButton) {
-        e->accept();
-        setSliderDown(true);
-        handleMouseEvent(e);
-    }
-    else {
-        QSlider::mousePressEvent(e);
-    }
+    return m_a;
 }
 
-void JumpableSlider::mouseMoveEvent(QMouseEvent* e)
+// hsv/hsl from rgb, undefined hue and saturation keep their previous value
+void ColorValue::updateFromRgb()
 {
-    if (e->buttons() & Qt::LeftButton) {
-        e->accept();
-        handleMouseEvent(e);
+    float maxc = std::max(m_r, std::max(m_g, m_b));
+    float minc = std::min(m_r, std::min(m_g, m_b));
+    float delta = maxc - minc;
+
+    m_v = maxc;
+    m_l = (maxc + minc) / 2;
+    if (delta > 0) {
+        float hue;
+        if (maxc == m_r) {
+            hue = (m_g - m_b) / delta;
+        }
+        else if (maxc == m_g) {
+            hue = 2 + (m_b - m_r) / delta;
+        }
+        else {
+            hue = 4 + (m_r - m_g) / delta;
+        }
+        hue /= 6;
+        m_h = hue < 0 ? hue + 1 : hue;
+        m_s = delta / maxc;
+        m_sl = delta / (1 - std::abs(2 * m_l - 1));
     }
-    else {
-        QSlider::mouseMoveEvent(e);
+    else if (maxc > 0) {
+        m_s = 0;
+        if (m_l < 1) m_sl = 0;
     }
 }
 
-void JumpableSlider::mouseReleaseEvent(QMouseEvent* e)
-{
-    QSlider::mouseReleaseEvent(e);
+void ColorValue::updateFromHsv()
+{
+    float hue = (m_h >= 1 ? 0 : m_h) * 6;
+    int i = static_cast<int>(hue);
+    float f = hue - i;
+    float pv = m_v * (1 - m_s);
+    float qv = m_v * (1 - m_s * f);
+    float tv = m_v * (1 - m_s * (1 - f));
+    switch (i) {
+        case 0: m_r = m_v, m_g = tv, m_b = pv; break;
+        case 1: m_r = qv, m_g = m_v, m_b = pv; break;
+        case 2: m_r = pv, m_g = m_v, m_b = tv; break;
+        case 3: m_r = pv, m_g = qv, m_b = m_v; break;
+        case 4: m_r = tv, m_g = pv, m_b = m_v; break;
+        default: m_r = m_v, m_g = pv, m_b = qv; break;
+    }
+    m_l = m_v * (1 - m_s / 2);
+    if (m_l > 0 && m_l < 1) {
+        m_sl = (m_v - m_l) / std::min(m_l, 1 - m_l);
+    }
 }
 
-void JumpableSlider::handleMouseEvent(QMouseEvent* e)
+void ColorValue::updateFromHsl()
 {
-    double newVal;
-    double maxValue = maximum();
-    double minValue = minimum();
-    if (orientation() == Qt::Horizontal) {
-        newVal = minValue + ((maxValue - minValue) * e->x()) / width();
-    }
-    else {
-        newVal = minValue + ((maxValue - minValue) * (height() - e->y())) / height();
+    m_v = m_l + m_sl * std::min(m_l, 1 - m_l);
+    if (m_v > 0) {
+        m_s = 2 * (1 - m_l / m_v);
     }
-    setValue(!invertedAppearance() ? newVal : maxValue - newVal);
+    // keep the exact hsl input, updateFromHsv derives it again with rounding errors
+    float lightness = m_l;
+    float hslSaturation = m_sl;
+    updateFromHsv();
+    m_l = lightness;
+    m_sl = hslSaturation;
 }
 
-class GradientSlider::Private
+//------------------------------------------------------ parallel batches -------------------------------------------
+namespace
+{
+class ChunkJob : public QRunnable
 {
 public:
-    ColorCorrection* colorCorrection = nullptr;
-    QLinearGradient gradient;
-    QImage colorBuffer;
-
-    Private() { gradient.setCoordinateMode(QGradient::StretchToDeviceMode); }
+    ChunkJob(const std::function<void(int, int)>& func, int begin, int end, QSemaphore* done)
+        : m_func(func)
+        , m_begin(begin)
+        , m_end(end)
+        , m_done(done)
+    {
+    }
 
-    void render(const QRect& rect, Qt::Orientation orientation, bool invertedAppearance)
+    void run() override
     {
-        QSize size = rect.size();
-        colorBuffer = QImage(size, QImage::Format_ARGB32);
-        // update gradient final stop
-        double dir = invertedAppearance ? -1 : 1;
-        if (orientation == Qt::Horizontal) {
-            gradient.setFinalStop(dir, 0);
+        m_func(m_begin, m_end);
+        m_done->release();
+    }
+
+private:
+    const std::function<void(int, int)>& m_func;
+    int m_begin;
+    int m_end;
+    QSemaphore* m_done;
+};
+
+// calls func on chunks of [0, count), chunks run inline when the global pool has no idle thread, so it never waits on a busy pool
+void parallelFor(int count, int grain, const std::function<void(int, int)>& func)
+{
+    auto pool = QThreadPool::globalInstance();
+    int chunks = std::min(pool->maxThreadCount(), count / std::max(grain, 1));
+    if (chunks <= 1) {
+        func(0, count);
+        return;
+    }
+
+    QSemaphore done;
+    int started = 0;
+    int chunkSize = (count + chunks - 1) / chunks;
+    for (int begin = chunkSize; begin < count; begin += chunkSize) {
+        int end = std::min(count, begin + chunkSize);
+        auto job = new ChunkJob(func, begin, end, &done);
+        if (pool->tryStart(job)) {
+            ++started;
         }
         else {
-            gradient.setFinalStop(0, -dir);
-        }
-
-        QPainter painter(&colorBuffer);
-        // draw gradient
-        painter.setBrush(gradient);
-        painter.drawRect(0, 0, colorBuffer.width(), colorBuffer.height());
-        // color correction
-        if (colorCorrection) {
-            colorCorrection->correct(colorBuffer);
+            delete job;
+            func(begin, end);
         }
     }
+    func(0, chunkSize);
+    done.acquire(started);
+}
+} // namespace
+
+//------------------------------------------------------ color space ------------------------------------------------
+namespace colorspace
+{
+namespace
+{
+// batches are converted as structure of arrays blocks, so the matrix steps can be vectorized
+const int blockSize = 256;
+// fewer colors than this aren't worth a thread
+const int parallelGrain = 16384;
+const float degrees = 57.2957795f;
+
+struct Block
+{
+    float x[blockSize];
+    float y[blockSize];
+    float z[blockSize];
 };
 
-GradientSlider::GradientSlider(QWidget* parent)
-    : JumpableSlider(Qt::Horizontal, parent)
-    , p(new Private)
+// sign preserving, so colors outside of srgb survive a round trip
+float decodeSrgb(float x)
 {
+    return x < 0 ? -float(Transfer<TransferKind::SRGB>::decode(-x)) : float(Transfer<TransferKind::SRGB>::decode(x));
 }
 
-GradientSlider::~GradientSlider() = default;
-
-void GradientSlider::setGradient(const QColor& startColor, const QColor& stopColor)
+float encodeSrgb(float x)
 {
-    setGradient({{0, startColor}, {1, stopColor}});
+    return x < 0 ? -float(Transfer<TransferKind::SRGB>::encode(-x)) : float(Transfer<TransferKind::SRGB>::encode(x));
 }
 
-void GradientSlider::setGradient(const QGradientStops& colors)
+const float* srgbDecode8()
 {
-    if (colors.size() <= 1) {
-        qWarning() << "ColorSlider::setGradient: colors size should >= 2";
-        return;
-    }
+    struct Table
+    {
+        float values[256];
+        Table()
+        {
+            for (int i = 0; i < 256; ++i) {
+                values[i] = decodeSrgb(i / 255.0f);
+            }
+        }
+    };
+    static const Table table;
+    return table.values;
+}
 
-    p->gradient.setStops(colors);
-    p->render(this->rect(), orientation(), invertedAppearance());
-    update();
+// cie lab companding with its linear segment near black
+const float labEpsilon = 216.0f / 24389;
+const float labKappa = 24389.0f / 27;
+
+float labF(float t)
+{
+    return t > labEpsilon ? std::cbrt(t) : (labKappa * t + 16) / 116;
 }
 
-void GradientSlider::setColorCorrection(ColorCorrection* colorCorrection)
+float labFInv(float t)
 {
-    p->colorCorrection = colorCorrection;
-    p->render(this->rect(), orientation(), invertedAppearance());
-    update();
+    return t * t * t > labEpsilon ? t * t * t : (116 * t - 16) / labKappa;
 }
 
-QGradientStops GradientSlider::gradientColor() const
+// linear srgb to space, in place
+void linearToSpace(Space space, Block& b, int n)
 {
-    return p->gradient.stops();
+    if (space == Space::OKLab || space == Space::OKLCH) {
+        for (int i = 0; i < n; ++i) {
+            float l = 0.4122214708f * b.x[i] + 0.5363325363f * b.y[i] + 0.0514459929f * b.z[i];
+            float m = 0.2119034982f * b.x[i] + 0.6806995451f * b.y[i] + 0.1073969566f * b.z[i];
+            float s = 0.0883024619f * b.x[i] + 0.2817188376f * b.y[i] + 0.6299787005f * b.z[i];
+            b.x[i] = l;
+            b.y[i] = m;
+            b.z[i] = s;
+        }
+        for (int i = 0; i < n; ++i) {
+            b.x[i] = std::cbrt(b.x[i]);
+            b.y[i] = std::cbrt(b.y[i]);
+            b.z[i] = std::cbrt(b.z[i]);
+        }
+        for (int i = 0; i < n; ++i) {
+            float l = b.x[i], m = b.y[i], s = b.z[i];
+            b.x[i] = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s;
+            b.y[i] = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+            b.z[i] = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+        }
+    }
+    else {
+        // xyz relative to the D65 white point
+        const float xn = 0.95047f;
+        const float zn = 1.08883f;
+        for (int i = 0; i < n; ++i) {
+            float x = (0.4124564f * b.x[i] + 0.3575761f * b.y[i] + 0.1804375f * b.z[i]) / xn;
+            float y = 0.2126729f * b.x[i] + 0.7151522f * b.y[i] + 0.0721750f * b.z[i];
+            float z = (0.0193339f * b.x[i] + 0.1191920f * b.y[i] + 0.9503041f * b.z[i]) / zn;
+            b.x[i] = x;
+            b.y[i] = y;
+            b.z[i] = z;
+        }
+        for (int i = 0; i < n; ++i) {
+            b.x[i] = labF(b.x[i]);
+            b.y[i] = labF(b.y[i]);
+            b.z[i] = labF(b.z[i]);
+        }
+        for (int i = 0; i < n; ++i) {
+            float fx = b.x[i], fy = b.y[i], fz = b.z[i];
+            b.x[i] = 116 * fy - 16;
+            b.y[i] = 500 * (fx - fy);
+            b.z[i] = 200 * (fy - fz);
+        }
+    }
+
+    if (isPolar(space)) {
+        for (int i = 0; i < n; ++i) {
+            float a = b.y[i], bb = b.z[i];
+            float h = std::atan2(bb, a) * degrees;
+            b.y[i] = std::sqrt(a * a + bb * bb);
+            b.z[i] = h < 0 ? h + 360 : h;
+        }
+    }
 }
 
-void GradientSlider::paintEvent(QPaintEvent* e)
+// space to linear srgb, in place
+void spaceToLinear(Space space, Block& b, int n)
 {
-    QPainter painter(this);
-    // draw groove
-    painter.drawImage(0, 0, p->colorBuffer);
+    if (isPolar(space)) {
+        for (int i = 0; i < n; ++i) {
+            float c = b.y[i], h = b.z[i] / degrees;
+            b.y[i] = c * std::cos(h);
+            b.z[i] = c * std::sin(h);
+        }
+    }
 
-    QPointF p1, p2;
-    if (orientation() == Qt::Horizontal) {
-        double pos = (value() - minimum()) / (maximum() - minimum()) * width();
-        p1 = QPointF(pos, 0);
-        p2 = QPointF(pos, height());
+    if (space == Space::OKLab || space == Space::OKLCH) {
+        for (int i = 0; i < n; ++i) {
+            float L = b.x[i], a = b.y[i], bb = b.z[i];
+            b.x[i] = L + 0.3963377774f * a + 0.2158037573f * bb;
+            b.y[i] = L - 0.1055613458f * a - 0.0638541728f * bb;
+            b.z[i] = L - 0.0894841775f * a - 1.2914855480f * bb;
+        }
+        for (int i = 0; i < n; ++i) {
+            b.x[i] = b.x[i] * b.x[i] * b.x[i];
+            b.y[i] = b.y[i] * b.y[i] * b.y[i];
+            b.z[i] = b.z[i] * b.z[i] * b.z[i];
+        }
+        for (int i = 0; i < n; ++i) {
+            float l = b.x[i], m = b.y[i], s = b.z[i];
+            b.x[i] = 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s;
+            b.y[i] = -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s;
+            b.z[i] = -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s;
+        }
     }
     else {
-        double pos = height() - (value() - minimum()) / (maximum() - minimum()) * height();
-        p1 = QPointF(0, pos);
-        p2 = QPointF(height(), pos);
+        const float xn = 0.95047f;
+        const float zn = 1.08883f;
+        for (int i = 0; i < n; ++i) {
+            float L = b.x[i];
+            float fy = (L + 16) / 116;
+            float fx = fy + b.y[i] / 500;
+            float fz = fy - b.z[i] / 200;
+            b.x[i] = labFInv(fx) * xn;
+            b.y[i] = L > 8 ? fy * fy * fy : L / labKappa;
+            b.z[i] = labFInv(fz) * zn;
+        }
+        for (int i = 0; i < n; ++i) {
+            float x = b.x[i], y = b.y[i], z = b.z[i];
+            b.x[i] = 3.2404542f * x - 1.5371385f * y - 0.4985314f * z;
+            b.y[i] = -0.9692660f * x + 1.8760108f * y + 0.0415560f * z;
+            b.z[i] = 0.0556434f * x - 0.2040259f * y + 1.0572252f * z;
+        }
     }
-    // draw handle
-    painter.setPen(QPen(QColor("#5C5C5C"), 6));
-    painter.drawLine(p1, p2);
 }
 
-void GradientSlider::resizeEvent(QResizeEvent* e)
+void load(Block& b, const Vec3* values, int n)
 {
-    p->render(this->rect(), orientation(), invertedAppearance());
+    for (int i = 0; i < n; ++i) {
+        b.x[i] = values[i].x;
+        b.y[i] = values[i].y;
+        b.z[i] = values[i].z;
+    }
 }
 
-class ColorSpinHSlider::Private
+void store(const Block& b, Vec3* values, int n)
 {
-public:
-    MixedSpinBox* spinbox;
-    GradientSlider* slider;
-
-    Private(const QString& name, QWidget* parent)
-    {
-        QLabel* text = new QLabel(name, parent);
-        text->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
-        spinbox = new MixedSpinBox(parent);
-        spinbox->setButtonSymbols(QAbstractSpinBox::NoButtons);
-        slider = new GradientSlider(parent);
-        slider->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
-        auto layout = new QHBoxLayout(parent);
-        layout->setAlignment(Qt::AlignLeft);
-        layout->setMargin(0);
-        layout->addWidget(text, 1);
-        layout->addWidget(spinbox, 2);
-        layout->addWidget(slider, 7);
+    for (int i = 0; i < n; ++i) {
+        values[i] = {b.x[i], b.y[i], b.z[i]};
     }
-};
-ColorSpinHSlider::ColorSpinHSlider(const QString& name, QWidget* parent)
-    : QWidget(parent)
-    , p(new Private(name, this))
-{
-    connect(p->slider, &GradientSlider::valueChanged, this, &ColorSpinHSlider::valueChanged);
-    connect(p->slider, &GradientSlider::valueChanged, p->spinbox, &MixedSpinBox::setValue);
-    connect(p->spinbox, &MixedSpinBox::editingFinished, this, [this]() { p->slider->setValue(p->spinbox->value()); });
 }
 
-ColorSpinHSlider::~ColorSpinHSlider() = default;
+Vec3 toLinear(Space space, const Vec3& color)
+{
+    Block b;
+    load(b, &color, 1);
+    spaceToLinear(space, b, 1);
+    Vec3 linear;
+    store(b, &linear, 1);
+    return linear;
+}
 
-void ColorSpinHSlider::setGradient(const QColor& startColor, const QColor& stopColor)
+Vec3 fromLinear(Space space, const Vec3& linear)
 {
-    p->slider->setGradient(startColor, stopColor);
+    Block b;
+    load(b, &linear, 1);
+    linearToSpace(space, b, 1);
+    Vec3 color;
+    store(b, &color, 1);
+    return color;
 }
 
-void ColorSpinHSlider::setGradient(const QGradientStops& colors)
+bool linearInGamut(const Vec3& linear)
 {
-    p->slider->setGradient(colors);
+    const float e = 1e-5f;
+    return linear.x >= -e && linear.x <= 1 + e && linear.y >= -e && linear.y <= 1 + e && linear.z >= -e && linear.z <= 1 + e;
 }
 
-void ColorSpinHSlider::setColorCorrection(ColorCorrection* colorCorrection)
+Vec3 clampLinear(const Vec3& linear)
 {
-    p->slider->setColorCorrection(colorCorrection);
+    return {qBound(0.0f, linear.x, 1.0f), qBound(0.0f, linear.y, 1.0f), qBound(0.0f, linear.z, 1.0f)};
 }
 
-void ColorSpinHSlider::setValue(double value)
+// max srgb chroma per degree of hue and per 1/100 of OKLCH lightness
+struct GamutBoundary
 {
-    p->spinbox->setValue(value);
-    p->slider->setValue(value);
+    static const int hueSteps = 360;
+    static const int lightnessSteps = 101;
+    float chroma[hueSteps][lightnessSteps];
+
+    // the only bisection, all lightness steps of a hue are searched together in one block
+    GamutBoundary()
+    {
+        Block b;
+        float low[lightnessSteps];
+        float high[lightnessSteps];
+        for (int h = 0; h < hueSteps; ++h) {
+            std::fill(low, low + lightnessSteps, 0.0f);
+            std::fill(high, high + lightnessSteps, 0.5f);
+            for (int iteration = 0; iteration < 20; ++iteration) {
+                for (int l = 0; l < lightnessSteps; ++l) {
+                    b.x[l] = 1.0f * l / (lightnessSteps - 1);
+                    b.y[l] = (low[l] + high[l]) / 2;
+                    b.z[l] = h;
+                }
+                spaceToLinear(Space::OKLCH, b, lightnessSteps);
+                for (int l = 0; l < lightnessSteps; ++l) {
+                    float mid = (low[l] + high[l]) / 2;
+                    (linearInGamut({b.x[l], b.y[l], b.z[l]}) ? low[l] : high[l]) = mid;
+                }
+            }
+            std::copy(low, low + lightnessSteps, chroma[h]);
+        }
+    }
+};
+
+// just noticeable difference in OKLab used by CSS Color 4
+const float css4Jnd = 0.02f;
+
+// OKLCH color into srgb, returns linear srgb
+Vec3 mapLch(const Vec3& lch, GamutMapping mapping)
+{
+    if (lch.x >= 1) return {1, 1, 1};
+    if (lch.x <= 0) return {0, 0, 0};
+
+    Vec3 linear = toLinear(Space::OKLCH, lch);
+    if (linearInGamut(linear) || mapping == GamutMapping::Clip) return clampLinear(linear);
+
+    float boundary = std::min(lch.y, maxChroma(lch.x, lch.z));
+    Vec3 reduced = {lch.x, boundary, lch.z};
+    if (mapping == GamutMapping::Css4) {
+        // clipping error is zero at the boundary and grows about linearly with chroma,
+        // so one secant step replaces the css bisection
+        Vec3 clipped = clampLinear(linear);
+        Vec3 lab = fromLinear(Space::OKLab, clipped);
+        float h = lch.z / degrees;
+        float da = lab.y - lch.y * std::cos(h);
+        float db = lab.z - lch.y * std::sin(h);
+        float dl = lab.x - lch.x;
+        float delta = std::sqrt(dl * dl + da * da + db * db);
+        if (delta < css4Jnd) return clipped;
+        reduced.y = boundary + (lch.y - boundary) * css4Jnd / delta;
+    }
+    return clampLinear(toLinear(Space::OKLCH, reduced));
 }
 
-void ColorSpinHSlider::setRange(double min, double max)
+} // namespace
+
+bool isPolar(Space space)
 {
-    p->slider->setRange(min, max);
-    p->spinbox->setRange(min, max);
+    return space == Space::OKLCH || space == Space::CIELCh;
 }
 
-QGradientStops ColorSpinHSlider::gradientColor() const
+Vec3 fromSrgb(Space space, const Vec3& rgb)
 {
-    return p->slider->gradientColor();
+    Vec3 color;
+    fromSrgb(space, &rgb, &color, 1);
+    return color;
 }
 
-double ColorSpinHSlider::value() const
+Vec3 toSrgb(Space space, const Vec3& color)
 {
-    return p->slider->value();
+    Vec3 rgb;
+    toSrgb(space, &color, &rgb, 1);
+    return rgb;
 }
 
-//--------------------------------------------- color button -------------------------------------------------------
-class ColorButton::Private
+void fromSrgb(Space space, const Vec3* rgb, Vec3* out, int count)
 {
-public:
-    QPoint pressPos;
-    QColor color;
-    ColorCorrection* colorCorrection = nullptr;
-    int bolderTopWidth = 0;
-    int bolderBottomWidth = 0;
-    int bolderLeftWidth = 0;
-    int bolderRightWidth = 0;
+    parallelFor(count, parallelGrain, [=](int begin, int end) {
+        Block b;
+        for (int i = begin; i < end; i += blockSize) {
+            int n = std::min(blockSize, end - i);
+            load(b, rgb + i, n);
+            for (int j = 0; j < n; ++j) {
+                b.x[j] = decodeSrgb(b.x[j]);
+                b.y[j] = decodeSrgb(b.y[j]);
+                b.z[j] = decodeSrgb(b.z[j]);
+            }
+            linearToSpace(space, b, n);
+            store(b, out + i, n);
+        }
+    });
+}
 
-    void updateStyle(QPushButton* btn)
-    {
-        QColor showColor = color;
-        if (colorCorrection) {
-            colorCorrection->correct(showColor);
+void toSrgb(Space space, const Vec3* colors, Vec3* rgb, int count)
+{
+    parallelFor(count, parallelGrain, [=](int begin, int end) {
+        Block b;
+        for (int i = begin; i < end; i += blockSize) {
+            int n = std::min(blockSize, end - i);
+            load(b, colors + i, n);
+            spaceToLinear(space, b, n);
+            for (int j = 0; j < n; ++j) {
+                b.x[j] = encodeSrgb(b.x[j]);
+                b.y[j] = encodeSrgb(b.y[j]);
+                b.z[j] = encodeSrgb(b.z[j]);
+            }
+            store(b, rgb + i, n);
         }
+    });
+}
 
-        int minWidth = DPI(20);
-        int minHeight = DPI(20);
-        auto style = QString("QPushButton{min-width:%1px;min-height:%2px;background-color:%3;"
-                             "border-top:%4px solid;border-bottom:%5px solid;"
-                             "border-left:%6px solid;border-right:%7px solid;}"
-                             "QPushButton:pressed{border: 1px solid #ffd700;}")
-                         .arg(minWidth)
-                         .arg(minHeight)
-                         .arg(showColor.name())
-                         .arg(bolderTopWidth)
-                         .arg(bolderBottomWidth)
-                         .arg(bolderLeftWidth)
-                         .arg(bolderRightWidth);
-        btn->setStyleSheet(style);
+void fromImage(Space space, const QImage& image, Vec3* out)
+{
+    const QImage argb = image.format() == QImage::Format_ARGB32 || image.format() == QImage::Format_RGB32
+                            ? image
+                            : image.convertToFormat(QImage::Format_ARGB32);
+    const int width = argb.width();
+    const float* decode = srgbDecode8();
+    parallelFor(argb.height(), parallelGrain / std::max(width, 1), [&](int begin, int end) {
+        Block b;
+        for (int y = begin; y < end; ++y) {
+            auto line = reinterpret_cast<const QRgb*>(argb.constScanLine(y));
+            for (int i = 0; i < width; i += blockSize) {
+                int n = std::min(blockSize, width - i);
+                for (int j = 0; j < n; ++j) {
+                    b.x[j] = decode[qRed(line[i + j])];
+                    b.y[j] = decode[qGreen(line[i + j])];
+                    b.z[j] = decode[qBlue(line[i + j])];
+                }
+                linearToSpace(space, b, n);
+                store(b, out + y * width + i, n);
+            }
+        }
+    });
+}
+
+bool inGamut(Space space, const Vec3& color)
+{
+    return linearInGamut(toLinear(space, color));
+}
+
+float maxChroma(float lightness, float hue)
+{
+    static const GamutBoundary boundary;
+    const int hueSteps = GamutBoundary::hueSteps;
+    const int lightnessSteps = GamutBoundary::lightnessSteps;
+
+    float l = qBound(0.0f, lightness, 1.0f) * (lightnessSteps - 1);
+    float h = hue - 360 * std::floor(hue / 360);
+    int l0 = std::min(static_cast<int>(l), lightnessSteps - 2);
+    int h0 = static_cast<int>(h) % hueSteps;
+    int h1 = (h0 + 1) % hueSteps;
+    float fl = l - l0;
+    float fh = h - std::floor(h);
+    float c0 = boundary.chroma[h0][l0] + (boundary.chroma[h0][l0 + 1] - boundary.chroma[h0][l0]) * fl;
+    float c1 = boundary.chroma[h1][l0] + (boundary.chroma[h1][l0 + 1] - boundary.chroma[h1][l0]) * fl;
+    return c0 + (c1 - c0) * fh;
+}
+
+Vec3 mapToGamut(Space space, const Vec3& color, GamutMapping mapping)
+{
+    Vec3 linear = toLinear(space, color);
+    if (linearInGamut(linear)) return color;
+
+    Vec3 mapped = mapping == GamutMapping::Clip ? clampLinear(linear)
+                                                : mapLch(space == Space::OKLCH ? color : fromLinear(Space::OKLCH, linear), mapping);
+    return fromLinear(space, mapped);
+}
+
+void mapToGamut(Space space, const Vec3* colors, Vec3* out, int count, GamutMapping mapping)
+{
+    parallelFor(count, parallelGrain / 4, [=](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            out[i] = mapToGamut(space, colors[i], mapping);
+        }
+    });
+}
+
+QImage toImage(Space space, const Vec3* colors, const QSize& size)
+{
+    QImage image(size, QImage::Format_ARGB32);
+    const int width = image.width();
+    // scanLine() detaches, take the bits once before writing from several threads
+    uchar* bits = image.bits();
+    const int bytesPerLine = image.bytesPerLine();
+    parallelFor(image.height(), parallelGrain / std::max(width, 1), [&](int begin, int end) {
+        Block b;
+        for (int y = begin; y < end; ++y) {
+            auto line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+            for (int i = 0; i < width; i += blockSize) {
+                int n = std::min(blockSize, width - i);
+                load(b, colors + y * width + i, n);
+                spaceToLinear(space, b, n);
+                for (int j = 0; j < n; ++j) {
+                    line[i + j] = qRgb(qRound(encodeSrgb(qBound(0.0f, b.x[j], 1.0f)) * 255),
+                                       qRound(encodeSrgb(qBound(0.0f, b.y[j], 1.0f)) * 255),
+                                       qRound(encodeSrgb(qBound(0.0f, b.z[j], 1.0f)) * 255));
+                }
+            }
+        }
+    });
+    return image;
+}
+} // namespace colorspace
+
+//------------------------------------------------------ color model ------------------------------------------------
+class ColorModel::Private
+{
+public:
+    ColorValue value;
+
+    static ColorModel::Channels diff(const ColorValue& from, const ColorValue& to)
+    {
+        ColorModel::Channels channels;
+        if (from.redF() != to.redF()) channels |= ColorModel::Red;
+        if (from.greenF() != to.greenF()) channels |= ColorModel::Green;
+        if (from.blueF() != to.blueF()) channels |= ColorModel::Blue;
+        if (from.hueF() != to.hueF()) channels |= ColorModel::Hue;
+        if (from.saturationF() != to.saturationF()) channels |= ColorModel::Saturation;
+        if (from.valueF() != to.valueF()) channels |= ColorModel::Value;
+        if (from.hslSaturationF() != to.hslSaturationF()) channels |= ColorModel::HslSaturation;
+        if (from.lightnessF() != to.lightnessF()) channels |= ColorModel::Lightness;
+        if (from.alphaF() != to.alphaF()) channels |= ColorModel::Alpha;
+        return channels;
     }
 };
 
-ColorButton::ColorButton(QWidget* parent)
-    : QPushButton(parent)
+ColorModel::ColorModel(QObject* parent)
+    : QObject(parent)
     , p(new Private)
 {
-    setAcceptDrops(true);
-    connect(this, &QPushButton::clicked, this, [this]() { emit colorClicked(p->color); });
 }
 
-ColorButton::~ColorButton() = default;
+ColorModel::~ColorModel() = default;
 
-void ColorButton::setColor(const QColor& color)
+void ColorModel::setColor(const QColor& color)
 {
-    p->color = color;
-    p->updateStyle(this);
+    if (!color.isValid()) return;
+    setValue(ColorValue(color, p->value));
 }
 
-void ColorButton::setColorCorrection(ColorCorrection* colorCorrection)
+void ColorModel::setValue(const ColorValue& value)
 {
-    p->colorCorrection = colorCorrection;
-    p->updateStyle(this);
+    auto channels = Private::diff(p->value, value);
+    p->value = value;
+    if (channels) emit colorChanged(channels);
 }
 
-void ColorButton::setBolderWidth(int top, int bottom, int left, int right)
+void ColorModel::setRgbF(float r, float g, float b)
 {
-    p->bolderTopWidth = top;
-    p->bolderBottomWidth = bottom;
-    p->bolderLeftWidth = left;
-    p->bolderRightWidth = right;
-    p->updateStyle(this);
+    setValue(ColorValue::fromRgbF(r, g, b, p->value));
 }
 
-QColor ColorButton::color() const
+void ColorModel::setHsvF(float h, float s, float v)
 {
-    return p->color;
+    setValue(ColorValue::fromHsvF(h, s, v, p->value));
 }
 
-void ColorButton::mousePressEvent(QMouseEvent* e)
+void ColorModel::setHslF(float h, float s, float l)
 {
-    p->pressPos = e->pos();
-    QPushButton::mousePressEvent(e);
+    setValue(ColorValue::fromHslF(h, s, l, p->value));
 }
 
-void ColorButton::mouseMoveEvent(QMouseEvent* e)
+void ColorModel::setChannel(Channel channel, float value)
 {
-    if (e->buttons() & Qt::LeftButton) {
-        if ((p->pressPos - e->pos()).manhattanLength() > QApplication::startDragDistance()) {
-            QMimeData* mime = new QMimeData;
-            mime->setColorData(p->color);
-            QPixmap pix(width(), height());
-            pix.fill(p->color);
-            QDrag* drg = new QDrag(this);
-            drg->setMimeData(mime);
-            drg->setPixmap(pix);
-            drg->exec(Qt::CopyAction);
-            // need let pushbutton release
-            QMouseEvent event(QEvent::MouseButtonRelease, e->pos(), Qt::LeftButton, Qt::LeftButton, 0);
-            QApplication::sendEvent(this, &event);
-        }
+    const auto& v = p->value;
+    switch (channel) {
+        case Red: setRgbF(value, v.greenF(), v.blueF()); break;
+        case Green: setRgbF(v.redF(), value, v.blueF()); break;
+        case Blue: setRgbF(v.redF(), v.greenF(), value); break;
+        case Hue: setHsvF(value, v.saturationF(), v.valueF()); break;
+        case Saturation: setHsvF(v.hueF(), value, v.valueF()); break;
+        case Value: setHsvF(v.hueF(), v.saturationF(), value); break;
+        case HslSaturation: setHslF(v.hueF(), value, v.lightnessF()); break;
+        case Lightness: setHslF(v.hueF(), v.hslSaturationF(), value); break;
+        case Alpha: setValue(ColorValue::fromAlphaF(value, v)); break;
+        default:
+            qWarning() << "ColorModel::setChannel: only single channel can be set";
+            break;
     }
 }
 
-void ColorButton::dragEnterEvent(QDragEnterEvent* e)
+QColor ColorModel::color() const
 {
-    if (qvariant_cast<QColor>(e->mimeData()->colorData()).isValid())
-        e->accept();
-    else
-        e->ignore();
+    return p->value.toColor();
 }
 
-void ColorButton::dragLeaveEvent(QDragLeaveEvent*)
+float ColorModel::channel(Channel channel) const
 {
-    if (hasFocus()) parentWidget()->setFocus();
+    const auto& v = p->value;
+    switch (channel) {
+        case Red: return v.redF();
+        case Green: return v.greenF();
+        case Blue: return v.blueF();
+        case Hue: return v.hueF();
+        case Saturation: return v.saturationF();
+        case Value: return v.valueF();
+        case HslSaturation: return v.hslSaturationF();
+        case Lightness: return v.lightnessF();
+        case Alpha: return v.alphaF();
+        default: return 0.0f;
+    }
 }
 
-void ColorButton::dropEvent(QDropEvent* e)
+float ColorModel::redF() const
 {
-    auto color = qvariant_cast<QColor>(e->mimeData()->colorData());
-    if (color.isValid()) {
-        setColor(color);
-        emit colorDroped(color);
-        e->accept();
+    return p->value.redF();
+}
+
+float ColorModel::greenF() const
+{
+    return p->value.greenF();
+}
+
+float ColorModel::blueF() const
+{
+    return p->value.blueF();
+}
+
+float ColorModel::hueF() const
+{
+    return p->value.hueF();
+}
+
+float ColorModel::saturationF() const
+{
+    return p->value.saturationF();
+}
+
+float ColorModel::valueF() const
+{
+    return p->value.valueF();
+}
+
+float ColorModel::hslSaturationF() const
+{
+    return p->value.hslSaturationF();
+}
+
+float ColorModel::lightnessF() const
+{
+    return p->value.lightnessF();
+}
+
+float ColorModel::alphaF() const
+{
+    return p->value.alphaF();
+}
+
+const ColorValue& ColorModel::value() const
+{
+    return p->value;
+}
+
+//------------------------------------------------------ render scheduler -------------------------------------------
+// state the jobs share, the scheduler waits for its pool before it goes away
+struct RenderQueue
+{
+    QThreadPool pool;
+    QMutex mutex;
+    // newest ticket of each owner, older jobs are dropped
+    QHash<QObject*, quint64> tickets;
+    quint64 nextTicket = 0;
+    RenderScheduler::Stats stats;
+
+    bool isLatest(QObject* owner, quint64 ticket) const { return tickets.value(owner, 0) == ticket; }
+};
+
+class RenderJob : public QRunnable
+{
+public:
+    RenderJob(RenderQueue* scheduler, QObject* owner, quint64 ticket, RenderScheduler::RenderFunc render,
+              RenderScheduler::ReadyFunc ready)
+        : m_scheduler(scheduler)
+        , m_owner(owner)
+        , m_ticket(ticket)
+        , m_render(render)
+        , m_ready(ready)
+    {
+        setAutoDelete(true);
     }
-    else {
-        e->ignore();
+
+    void run() override
+    {
+        {
+            QMutexLocker locker(&m_scheduler->mutex);
+            if (!m_scheduler->isLatest(m_owner, m_ticket)) {
+                ++m_scheduler->stats.droppedJobs;
+                return;
+            }
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        QImage image = m_render();
+        qint64 nsecs = timer.nsecsElapsed();
+
+        // post under lock, owner can't be destroyed before the event is queued, see cancel()
+        QMutexLocker locker(&m_scheduler->mutex);
+        auto& stats = m_scheduler->stats;
+        ++stats.renderedJobs;
+        stats.totalNsecs += nsecs;
+        stats.lastNsecs = nsecs;
+        stats.lastBytes = qint64(image.bytesPerLine()) * image.height();
+        if (!m_scheduler->isLatest(m_owner, m_ticket)) {
+            ++stats.droppedJobs;
+            return;
+        }
+
+        auto scheduler = m_scheduler;
+        auto owner = m_owner;
+        auto ticket = m_ticket;
+        auto ready = m_ready;
+        QMetaObject::invokeMethod(
+            owner,
+            [scheduler, owner, ticket, ready, image]() {
+                {
+                    QMutexLocker locker(&scheduler->mutex);
+                    if (!scheduler->isLatest(owner, ticket)) return;
+                }
+                ready(image);
+            },
+            Qt::QueuedConnection);
+    }
+
+private:
+    RenderQueue* m_scheduler;
+    QObject* m_owner;
+    quint64 m_ticket;
+    RenderScheduler::RenderFunc m_render;
+    RenderScheduler::ReadyFunc m_ready;
+};
+
+class RenderScheduler::Private
+{
+public:
+    RenderQueue queue;
+};
+
+RenderScheduler::RenderScheduler()
+    : p(new Private)
+{
+}
+
+RenderScheduler::~RenderScheduler()
+{
+    p->queue.pool.waitForDone();
+}
+
+RenderScheduler* RenderScheduler::instance()
+{
+    static RenderScheduler scheduler;
+    return &scheduler;
+}
+
+void RenderScheduler::submit(QObject* owner, RenderFunc render, ReadyFunc ready)
+{
+    quint64 ticket;
+    {
+        QMutexLocker locker(&p->queue.mutex);
+        ticket = ++p->queue.nextTicket;
+        p->queue.tickets[owner] = ticket;
     }
+    p->queue.pool.start(new RenderJob(&p->queue, owner, ticket, render, ready));
 }
 
-//--------------------------------------------- color palette ------------------------------------------------------
-class ColorPalette::Private
+void RenderScheduler::cancel(QObject* owner)
+{
+    QMutexLocker locker(&p->queue.mutex);
+    p->queue.tickets.remove(owner);
+}
+
+void RenderScheduler::waitForDone()
+{
+    p->queue.pool.waitForDone();
+}
+
+RenderScheduler::Stats RenderScheduler::stats() const
+{
+    QMutexLocker locker(&p->queue.mutex);
+    return p->queue.stats;
+}
+
+void RenderScheduler::resetStats()
+{
+    QMutexLocker locker(&p->queue.mutex);
+    p->queue.stats = Stats();
+}
+
+//--------------------------------------------------------- color wheel ------------------------------------------------
+class ColorWheel::Private
 {
 public:
-    int columnCount = 0;
-    QGridLayout* layout = nullptr;
-    ColorCorrection* colorCorrection = nullptr;
-    QVector<QColor> colors;
+    static constexpr int selectorRadius = 4;
+    static constexpr int comboSelectorRadius = 3;
+    int radius = 0;
+    QColor selectedColor = QColor(Qt::white);
+    ColorValue selectedValue;
+    QImage colorBuffer;
+    colorcombo::ICombination* colorCombination = nullptr;
+    ColorCorrectionPtr colorCorrection;
 
-    Private(int column, QScrollArea* parent)
+    void renderWheel(ColorWheel* wheel)
     {
-        columnCount = column;
+        const QRect rect = wheel->rect();
+        radius = std::min(rect.width(), rect.height()) / 2 - selectorRadius;
 
-        auto scrollWidget = new QWidget(parent);
-        layout = new QGridLayout(scrollWidget);
-        layout->setAlignment(Qt::AlignTop);
-        layout->setSpacing(0);
-        layout->setMargin(0);
+        // render in worker thread with copies of the current state, buffer is swapped when ready
+        const int wheelRadius = radius;
+        const float value = selectedValue.valueF();
+        const ColorCorrectionPtr correction = colorCorrection;
+        RenderScheduler::instance()->submit(
+            wheel, [=]() { return render(rect, wheelRadius, value, correction.get()); },
+            [this, wheel](const QImage& image) {
+                colorBuffer = image;
+                wheel->update();
+            });
+    }
 
-        parent->setWidget(scrollWidget);
+    static QImage render(const QRect& rect, int radius, float value, const ColorCorrection* colorCorrection)
+    {
+        auto center = rect.center();
+        auto size = rect.size();
+
+        // init buffer
+        QImage colorBuffer(size, colorCorrection ? colorCorrection->renderFormat() : QImage::Format_ARGB32);
+        colorBuffer.fill(Qt::transparent);
+
+        // create gradient
+        QConicalGradient hsvGradient(center, 0);
+        for (int deg = 0; deg < 360; deg += 60) {
+            hsvGradient.setColorAt(deg / 360.0, QColor::fromHsvF(deg / 360.0, 1.0, value));
+        }
+        hsvGradient.setColorAt(1.0, QColor::fromHsvF(0.0, 1.0, value));
+
+        QRadialGradient valueGradient(center, radius);
+        valueGradient.setColorAt(0.0, QColor::fromHsvF(0.0, 0.0, value));
+        valueGradient.setColorAt(1.0, Qt::transparent);
+
+        {
+            QPainter painter(&colorBuffer);
+            painter.setRenderHint(QPainter::Antialiasing, true);
+            // draw color wheel
+            painter.setPen(Qt::transparent);
+            painter.setBrush(hsvGradient);
+            painter.drawEllipse(center, radius, radius);
+            painter.setBrush(valueGradient);
+            painter.drawEllipse(center, radius, radius);
+        }
+
+        // color correction
+        if (colorCorrection) {
+            colorCorrection->correct(colorBuffer);
+        }
+        return colorBuffer;
+    }
+};
+
+ColorWheel::ColorWheel(QWidget* parent)
+    : QWidget(parent)
+    , p(new Private)
+{
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+}
+
+ColorWheel::~ColorWheel()
+{
+    RenderScheduler::instance()->cancel(this);
+}
+
+void ColorWheel::setColorCombination(colorcombo::ICombination* combination)
+{
+    p->colorCombination = combination;
+    repaint();
+}
+
+void ColorWheel::setSelectedColor(const QColor& color)
+{
+    if (!isEnabled()) return;
+
+    ColorValue value(color, p->selectedValue);
+    bool valueChanged = value.valueF() != p->selectedValue.valueF();
+    p->selectedColor = color;
+    p->selectedValue = value;
+    if (valueChanged) {
+        p->renderWheel(this);
+    }
+    update();
+}
+
+void ColorWheel::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->renderWheel(this);
+}
+
+QColor ColorWheel::getSelectedColor() const
+{
+    return p->selectedColor;
+}
+
+QColor ColorWheel::getColor(int x, int y) const
+{
+    if (p->radius <= 0) return QColor();
+
+    auto line = QLineF(this->rect().center(), QPointF(x, y));
+    auto h = line.angle() / 360.0;
+    auto s = std::min(1.0, line.length() / p->radius);
+    auto v = p->selectedValue.valueF();
+    return QColor::fromHsvF(h, s, v);
+}
+
+void ColorWheel::paintEvent(QPaintEvent* e)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing, true);
+    // draw wheel
+    painter.drawImage(0, 0, p->colorBuffer);
+    // draw selected color circle
+    painter.setPen(Qt::black);
+    painter.setBrush(Qt::white);
+    drawSelector(&painter, p->selectedValue, p->selectorRadius);
+    // draw color combination circle
+    if (p->colorCombination) {
+        auto colors = p->colorCombination->genColors(p->selectedColor);
+        for (const auto& color : colors) {
+            drawSelector(&painter, ColorValue(color, p->selectedValue), p->comboSelectorRadius);
+        }
+        // add selected color, so the user can switch between this
+        colors.push_back(p->selectedColor);
+        emit combinationColorChanged(colors);
+    }
+}
+
+void ColorWheel::mousePressEvent(QMouseEvent* e)
+{
+    processMouseEvent(e);
+}
+
+void ColorWheel::mouseMoveEvent(QMouseEvent* e)
+{
+    processMouseEvent(e);
+}
+
+void ColorWheel::resizeEvent(QResizeEvent* e)
+{
+    p->renderWheel(this);
+}
+
+void ColorWheel::processMouseEvent(QMouseEvent* e)
+{
+    if (e->buttons() & Qt::LeftButton) {
+        p->selectedColor = getColor(e->x(), e->y());
+        p->selectedValue = ColorValue(p->selectedColor, p->selectedValue);
+        emit colorSelected(p->selectedColor);
+        update();
+    }
+}
+
+void ColorWheel::drawSelector(QPainter* painter, const ColorValue& color, int radius)
+{
+    auto line = QLineF::fromPolar(color.saturationF() * p->radius, color.hueF() * 360.0);
+    line.translate(this->rect().center());
+    painter->drawEllipse(line.p2(), radius, radius);
+}
+
+//-------------------------------------------------- color combination --------------------------------------------
+namespace colorcombo
+{
+namespace
+{
+float wrapHue(float h)
+{
+    return h - std::floor(h);
+}
+
+HsvF toHsvF(const QColor& color, const HsvF& previous)
+{
+    // hue of an achromatic color is undefined, keep the previous one
+    float h = color.hsvHueF();
+    return {h < 0 ? previous.h : float(h), float(color.hsvSaturationF()), float(color.valueF())};
+}
+} // namespace
+
+ICombination::ICombination(QObject* parent)
+    : QObject(parent)
+    , m_min(0)
+    , m_max(1)
+    , m_value(0)
+    , m_decimals(0)
+    , m_rangeEnabled(false)
+{
+}
+
+ICombination::ICombination(double min, double max, double value, int decimals, bool rangeEnabled, QObject* parent)
+    : QObject(parent)
+    , m_min(min)
+    , m_max(max)
+    , m_value(value)
+    , m_decimals(decimals)
+    , m_rangeEnabled(rangeEnabled)
+{
+}
+
+QString ICombination::name()
+{
+    return tr("None");
+}
+
+int ICombination::colorCount() const
+{
+    return 0;
+}
+
+void ICombination::genColors(const HsvF*, int, double, HsvF*) const
+{
+    // colorCount() is 0, nothing to write
+}
+
+void ICombination::genColors(const HsvF* colors, int count, HsvF* out) const
+{
+    genColors(colors, count, getValue(), out);
+}
+
+QVector<QColor> ICombination::genColors(const QColor& color) const
+{
+    const int n = colorCount();
+    if (n == 0) return {};
+
+    // an achromatic color has hue -1, the integer math wrapped it to 359
+    HsvF base = toHsvF(color, {359.0f / 360, 0, 0});
+    QVector<HsvF> out(n);
+    genColors(&base, 1, out.data());
+    QVector<QColor> colors(n);
+    for (int i = 0; i < n; ++i) {
+        colors[i] = QColor::fromHsvF(out[i].h, out[i].s, out[i].v);
+    }
+    return colors;
+}
+
+void ICombination::setRange(double min, double max)
+{
+    m_min = min;
+    m_max = max;
+}
+
+void ICombination::setValue(double value)
+{
+    m_value = value;
+}
+
+void ICombination::setDecimals(int decimals)
+{
+    m_decimals = decimals;
+}
+
+double ICombination::min() const
+{
+    return m_min;
+}
+
+double ICombination::max() const
+{
+    return m_max;
+}
+
+double ICombination::getValue() const
+{
+    return m_value;
+}
+
+bool ICombination::rangeEnabled() const
+{
+    return m_rangeEnabled;
+}
+
+int ICombination::decimals() const
+{
+    return m_decimals;
+}
+
+Complementary::Complementary(QObject* parent)
+    : ICombination(parent)
+{
+}
+
+QString Complementary::name()
+{
+    return tr("Complementary");
+}
+
+int Complementary::colorCount() const
+{
+    return 1;
+}
+
+void Complementary::genColors(const HsvF* colors, int count, double, HsvF* out) const
+{
+    for (int i = 0; i < count; ++i) {
+        out[i] = {wrapHue(colors[i].h + 0.5f), colors[i].s, colors[i].v};
+    }
+}
+
+Monochromatic::Monochromatic(QObject* parent)
+    : ICombination(0, 1, 0.5, 4, true, parent)
+{
+}
+
+QString Monochromatic::name()
+{
+    return tr("Monochromatic");
+}
+
+int Monochromatic::colorCount() const
+{
+    return 1;
+}
+
+void Monochromatic::genColors(const HsvF* colors, int count, double value, HsvF* out) const
+{
+    const float rate = value / (max() - min());
+    for (int i = 0; i < count; ++i) {
+        out[i] = {colors[i].h, colors[i].s, colors[i].v * rate};
+    }
+}
+
+Analogous::Analogous(QObject* parent)
+    : ICombination(0, 180, 30, 0, true, parent)
+{
+}
+
+QString Analogous::name()
+{
+    return tr("Analogous");
+}
+
+int Analogous::colorCount() const
+{
+    return 2;
+}
+
+void Analogous::genColors(const HsvF* colors, int count, double value, HsvF* out) const
+{
+    const float add = value / 360;
+    for (int i = 0; i < count; ++i) {
+        out[2 * i] = {wrapHue(colors[i].h + add), colors[i].s, colors[i].v};
+        out[2 * i + 1] = {wrapHue(colors[i].h - add), colors[i].s, colors[i].v};
+    }
+}
+
+Triadic::Triadic(QObject* parent)
+    : ICombination(0, 180, 120, 0, true, parent)
+{
+}
+
+QString Triadic::name()
+{
+    return tr("Triadic");
+}
+
+int Triadic::colorCount() const
+{
+    return 2;
+}
+
+void Triadic::genColors(const HsvF* colors, int count, double value, HsvF* out) const
+{
+    const float add = value / 360;
+    for (int i = 0; i < count; ++i) {
+        out[2 * i] = {wrapHue(colors[i].h + add), colors[i].s, colors[i].v};
+        out[2 * i + 1] = {wrapHue(colors[i].h - add), colors[i].s, colors[i].v};
+    }
+}
+
+Tetradic::Tetradic(QObject* parent)
+    : ICombination(-90, 90, 90, 0, true, parent)
+{
+}
+
+QString Tetradic::name()
+{
+    return tr("Tetradic");
+}
+
+int Tetradic::colorCount() const
+{
+    return 3;
+}
+
+void Tetradic::genColors(const HsvF* colors, int count, double value, HsvF* out) const
+{
+    /*
+     * A--------B
+     * |        |
+     * D--------C
+     *
+     * A : H, S, V
+     * B : H - 90 + factor * 180, S, V
+     * C : H + 180, S, V
+     * D : H + 90 + factor * 180, S, V
+     */
+    const float add = value / 360;
+    for (int i = 0; i < count; ++i) {
+        out[3 * i] = {wrapHue(colors[i].h + add), colors[i].s, colors[i].v};
+        out[3 * i + 1] = {wrapHue(colors[i].h + 0.5f), colors[i].s, colors[i].v};
+        out[3 * i + 2] = {wrapHue(colors[i].h + add + 0.5f), colors[i].s, colors[i].v};
+    }
+}
+
+RuleCombination::RuleCombination(const QString& name, const QVector<Operation>& operations, QObject* parent)
+    : ICombination(parent)
+    , m_name(name)
+    , m_operations(operations)
+{
+}
+
+RuleCombination::RuleCombination(const QString& name, const QVector<Operation>& operations, double min, double max,
+                                 double value, int decimals, QObject* parent)
+    : ICombination(min, max, value, decimals, true, parent)
+    , m_name(name)
+    , m_operations(operations)
+{
+}
+
+/*
+ * {
+ *     "name": "Split Complementary",
+ *     "range": {"min": 0, "max": 90, "value": 30, "decimals": 0},
+ *     "colors": [
+ *         {"hue": 180, "hueFactor": 1},
+ *         {"hue": 180, "hueFactor": -1, "saturation": 0.8, "lightness": 1.1}
+ *     ]
+ * }
+ *
+ * hue in degrees, saturation and value/lightness are scales, every key has a "Factor" per parameter unit
+ * range is optional, without it the factor slider is disabled
+ */
+QVector<RuleCombination*> RuleCombination::fromJson(const QByteArray& json, QObject* parent)
+{
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &error);
+    if (document.isNull()) {
+        qWarning() << "RuleCombination::fromJson:" << error.errorString();
+        return {};
+    }
+
+    QJsonArray rules = document.isArray() ? document.array() : QJsonArray{document.object()};
+    QVector<RuleCombination*> combinations;
+    for (const auto& value : rules) {
+        const QJsonObject rule = value.toObject();
+        const QString name = rule.value("name").toString();
+        const QJsonArray colors = rule.value("colors").toArray();
+        if (name.isEmpty() || colors.isEmpty()) {
+            qWarning() << "RuleCombination::fromJson: rule needs a name and colors" << rule;
+            continue;
+        }
+
+        QVector<Operation> operations;
+        for (const auto& color : colors) {
+            const QJsonObject object = color.toObject();
+            const bool lightness = object.contains("lightness") || object.contains("lightnessFactor");
+            const QString level = lightness ? "lightness" : "value";
+            operations.append({float(object.value("hue").toDouble(0) / 360), float(object.value("hueFactor").toDouble(0) / 360),
+                               float(object.value("saturation").toDouble(1)), float(object.value("saturationFactor").toDouble(0)),
+                               float(object.value(level).toDouble(1)), float(object.value(level + "Factor").toDouble(0)), lightness});
+        }
+
+        if (rule.contains("range")) {
+            const QJsonObject range = rule.value("range").toObject();
+            double min = range.value("min").toDouble(0);
+            double max = range.value("max").toDouble(1);
+            combinations.append(new RuleCombination(name, operations, min, max, range.value("value").toDouble(min),
+                                                    range.value("decimals").toInt(0), parent));
+        }
+        else {
+            combinations.append(new RuleCombination(name, operations, parent));
+        }
+    }
+    return combinations;
+}
+
+QVector<RuleCombination*> RuleCombination::fromFile(const QString& fileName, QObject* parent)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "RuleCombination::fromFile: can't open" << fileName;
+        return {};
+    }
+    return fromJson(file.readAll(), parent);
+}
+
+QString RuleCombination::name()
+{
+    return m_name;
+}
+
+int RuleCombination::colorCount() const
+{
+    return m_operations.size();
+}
+
+void RuleCombination::genColors(const HsvF* colors, int count, double value, HsvF* out) const
+{
+    // the parameter is folded in once per call, the loop only walks the flat list
+    struct Resolved
+    {
+        float hue;
+        float saturation;
+        float level;
+        bool lightness;
+    };
+    const float parameter = value;
+    const int n = m_operations.size();
+    QVarLengthArray<Resolved, 16> resolved(n);
+    for (int j = 0; j < n; ++j) {
+        const Operation& op = m_operations[j];
+        resolved[j] = {op.hue + op.hueFactor * parameter, op.saturation + op.saturationFactor * parameter,
+                       op.level + op.levelFactor * parameter, op.lightness};
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const HsvF& color = colors[i];
+        for (int j = 0; j < n; ++j) {
+            const Resolved& op = resolved[j];
+            HsvF& result = out[i * n + j];
+            result.h = wrapHue(color.h + op.hue);
+            if (!op.lightness) {
+                result.s = qBound(0.0f, color.s * op.saturation, 1.0f);
+                result.v = qBound(0.0f, color.v * op.level, 1.0f);
+                continue;
+            }
+            // hsv to hsl, scale, and back
+            float l = color.v * (1 - color.s / 2);
+            float sl = l > 0 && l < 1 ? (color.v - l) / std::min(l, 1 - l) : 0;
+            l = qBound(0.0f, l * op.level, 1.0f);
+            sl = qBound(0.0f, sl * op.saturation, 1.0f);
+            result.v = l + sl * std::min(l, 1 - l);
+            result.s = result.v > 0 ? 2 * (1 - l / result.v) : 0;
+        }
+    }
+}
+
+QVector<RuleCombination::Operation> RuleCombination::operations() const
+{
+    return m_operations;
+}
+} // namespace colorcombo
+
+//-------------------------------------------------- color difference --------------------------------------------
+namespace colordiff
+{
+using colorspace::Vec3;
+
+namespace
+{
+// a CIEDE2000 distance costs about as much as a few hundred CIE76 ones, chunks are smaller
+const int parallelGrain = 4096;
+const float degrees = 57.2957795f;
+
+float delta76(const Vec3& a, const Vec3& b)
+{
+    float dl = a.x - b.x;
+    float da = a.y - b.y;
+    float db = a.z - b.z;
+    return std::sqrt(dl * dl + da * da + db * db);
+}
+
+float delta94(const Vec3& a, const Vec3& b)
+{
+    float c1 = std::sqrt(a.y * a.y + a.z * a.z);
+    float c2 = std::sqrt(b.y * b.y + b.z * b.z);
+    float dl = a.x - b.x;
+    float dc = c1 - c2;
+    float da = a.y - b.y;
+    float db = a.z - b.z;
+    float dh2 = std::max(0.0f, da * da + db * db - dc * dc);
+    float sc = 1 + 0.045f * c1;
+    float sh = 1 + 0.015f * c1;
+    return std::sqrt(dl * dl + dc * dc / (sc * sc) + dh2 / (sh * sh));
+}
+
+float delta2000(const Vec3& a, const Vec3& b)
+{
+    const float pow25to7 = 6103515625.0f;
+    float c1 = std::sqrt(a.y * a.y + a.z * a.z);
+    float c2 = std::sqrt(b.y * b.y + b.z * b.z);
+    float cMean = (c1 + c2) / 2;
+    float cMean7 = std::pow(cMean, 7.0f);
+    float g = 0.5f * (1 - std::sqrt(cMean7 / (cMean7 + pow25to7)));
+    float a1 = (1 + g) * a.y;
+    float a2 = (1 + g) * b.y;
+    float c1p = std::sqrt(a1 * a1 + a.z * a.z);
+    float c2p = std::sqrt(a2 * a2 + b.z * b.z);
+    float h1p = (a1 == 0 && a.z == 0) ? 0 : std::atan2(a.z, a1) * degrees;
+    float h2p = (a2 == 0 && b.z == 0) ? 0 : std::atan2(b.z, a2) * degrees;
+    if (h1p < 0) h1p += 360;
+    if (h2p < 0) h2p += 360;
+
+    float dlp = b.x - a.x;
+    float dcp = c2p - c1p;
+    float dhp = 0;
+    float hMean = h1p + h2p;
+    if (c1p * c2p != 0) {
+        dhp = h2p - h1p;
+        if (dhp > 180) dhp -= 360;
+        else if (dhp < -180) dhp += 360;
+        if (std::abs(h1p - h2p) <= 180) hMean = (h1p + h2p) / 2;
+        else if (h1p + h2p < 360) hMean = (h1p + h2p + 360) / 2;
+        else hMean = (h1p + h2p - 360) / 2;
+    }
+    float dHp = 2 * std::sqrt(c1p * c2p) * std::sin(dhp / 2 / degrees);
+
+    float lMean = (a.x + b.x) / 2;
+    float cpMean = (c1p + c2p) / 2;
+    float t = 1 - 0.17f * std::cos((hMean - 30) / degrees) + 0.24f * std::cos(2 * hMean / degrees)
+              + 0.32f * std::cos((3 * hMean + 6) / degrees) - 0.20f * std::cos((4 * hMean - 63) / degrees);
+    float dTheta = 30 * std::exp(-((hMean - 275) / 25) * ((hMean - 275) / 25));
+    float cpMean7 = std::pow(cpMean, 7.0f);
+    float rc = 2 * std::sqrt(cpMean7 / (cpMean7 + pow25to7));
+    float l50 = (lMean - 50) * (lMean - 50);
+    float sl = 1 + 0.015f * l50 / std::sqrt(20 + l50);
+    float sc = 1 + 0.045f * cpMean;
+    float sh = 1 + 0.015f * cpMean * t;
+    float rt = -std::sin(2 * dTheta / degrees) * rc;
+
+    float tl = dlp / sl;
+    float tc = dcp / sc;
+    float th = dHp / sh;
+    return std::sqrt(std::max(0.0f, tl * tl + tc * tc + th * th + rt * tc * th));
+}
+
+// the metric is dispatched once per run, so each loop can be vectorized on its own
+void kernel(Metric metric, const Vec3& color, const Vec3* colors, float* out, int count)
+{
+    switch (metric) {
+        case Metric::CIE76:
+        case Metric::OK:
+            for (int i = 0; i < count; ++i) out[i] = delta76(color, colors[i]);
+            break;
+        case Metric::CIE94:
+            for (int i = 0; i < count; ++i) out[i] = delta94(color, colors[i]);
+            break;
+        case Metric::CIEDE2000:
+            for (int i = 0; i < count; ++i) out[i] = delta2000(color, colors[i]);
+            break;
+    }
+}
+
+// a lightness difference alone is at most this many times the whole distance
+float lightnessBound(Metric metric)
+{
+    // CIEDE2000 divides it by SL, which stays below 1.75 for L* in 0..100
+    return metric == Metric::CIEDE2000 ? 1.75f : 1.0f;
+}
+} // namespace
+
+colorspace::Space spaceOf(Metric metric)
+{
+    return metric == Metric::OK ? colorspace::Space::OKLab : colorspace::Space::CIELab;
+}
+
+Vec3 prepare(Metric metric, const QColor& color)
+{
+    return colorspace::fromSrgb(spaceOf(metric), {float(color.redF()), float(color.greenF()), float(color.blueF())});
+}
+
+QVector<Vec3> prepare(Metric metric, const QVector<QColor>& colors)
+{
+    QVector<Vec3> rgb(colors.size());
+    for (int i = 0; i < colors.size(); ++i) {
+        rgb[i] = {float(colors[i].redF()), float(colors[i].greenF()), float(colors[i].blueF())};
+    }
+    QVector<Vec3> prepared(colors.size());
+    colorspace::fromSrgb(spaceOf(metric), rgb.constData(), prepared.data(), rgb.size());
+    return prepared;
+}
+
+float distance(Metric metric, const Vec3& a, const Vec3& b)
+{
+    float d;
+    kernel(metric, a, &b, &d, 1);
+    return d;
+}
+
+void distances(Metric metric, const Vec3& color, const Vec3* colors, float* out, int count)
+{
+    parallelFor(count, parallelGrain, [=](int begin, int end) { kernel(metric, color, colors + begin, out + begin, end - begin); });
+}
+
+void distances(Metric metric, const Vec3* rows, int rowCount, const Vec3* columns, int columnCount, float* out)
+{
+    parallelFor(rowCount, parallelGrain / std::max(columnCount, 1), [=](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            kernel(metric, rows[i], columns, out + i * columnCount, columnCount);
+        }
+    });
+}
+
+int nearest(Metric metric, const Vec3& color, const Vec3* colors, int count, float* distance)
+{
+    if (count <= 0) return -1;
+
+    std::vector<float> d(count);
+    distances(metric, color, colors, d.data(), count);
+    int index = std::min_element(d.begin(), d.end()) - d.begin();
+    if (distance) *distance = d[index];
+    return index;
+}
+
+QVector<QPair<int, int>> duplicates(Metric metric, const Vec3* colors, int count, float threshold)
+{
+    // sweep in lightness order, only colors within the lightness bound of the threshold can be closer
+    std::vector<int> order(count);
+    for (int i = 0; i < count; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [colors](int a, int b) { return colors[a].x < colors[b].x; });
+    const float window = threshold * lightnessBound(metric);
+
+    QVector<QPair<int, int>> pairs;
+    QMutex mutex;
+    parallelFor(count, parallelGrain / 16, [&](int begin, int end) {
+        QVector<QPair<int, int>> found;
+        std::vector<Vec3> candidates;
+        std::vector<int> indexes;
+        std::vector<float> d;
+        for (int i = begin; i < end; ++i) {
+            const Vec3& color = colors[order[i]];
+            candidates.clear();
+            indexes.clear();
+            for (int j = i + 1; j < count && colors[order[j]].x - color.x <= window; ++j) {
+                candidates.push_back(colors[order[j]]);
+                indexes.push_back(order[j]);
+            }
+            d.resize(candidates.size());
+            kernel(metric, color, candidates.data(), d.data(), int(candidates.size()));
+            for (size_t j = 0; j < d.size(); ++j) {
+                // CIE94 isn't symmetric, a pair counts if it is close from either side
+                if (d[j] < threshold || (metric == Metric::CIE94 && delta94(candidates[j], color) < threshold)) {
+                    found.append({std::min(order[i], indexes[j]), std::max(order[i], indexes[j])});
+                }
+            }
+        }
+        QMutexLocker locker(&mutex);
+        pairs += found;
+    });
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+} // namespace colordiff
+
+//-------------------------------------------------- color contrast --------------------------------------------
+namespace contrast
+{
+float luminance(const QColor& color)
+{
+    auto decode = [](double x) { return Transfer<TransferKind::SRGB>::decode(x); };
+    return 0.2126 * decode(color.redF()) + 0.7152 * decode(color.greenF()) + 0.0722 * decode(color.blueF());
+}
+
+float ratio(float luminance1, float luminance2)
+{
+    return (std::max(luminance1, luminance2) + 0.05f) / (std::min(luminance1, luminance2) + 0.05f);
+}
+
+float apcaLuminance(const QColor& color)
+{
+    auto decode = [](double x) { return std::pow(x, 2.4); };
+    float y = 0.2126729 * decode(color.redF()) + 0.7151522 * decode(color.greenF()) + 0.0721750 * decode(color.blueF());
+    // soft clamp near black
+    return y < 0.022f ? y + std::pow(0.022f - y, 1.414f) : y;
+}
+
+float apca(float textLuminance, float backgroundLuminance)
+{
+    if (std::abs(backgroundLuminance - textLuminance) < 0.0005f) return 0;
+
+    if (backgroundLuminance > textLuminance) {
+        float s = (std::pow(backgroundLuminance, 0.56f) - std::pow(textLuminance, 0.57f)) * 1.14f;
+        return s < 0.1f ? 0 : (s - 0.027f) * 100;
+    }
+    float s = (std::pow(backgroundLuminance, 0.65f) - std::pow(textLuminance, 0.62f)) * 1.14f;
+    return s > -0.1f ? 0 : (s + 0.027f) * 100;
+}
+} // namespace contrast
+
+//-------------------------------------------------- palette generator -------------------------------------------
+namespace palettegen
+{
+namespace
+{
+quint64 splitMix(quint64 x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// counter based, a candidate only depends on the seed and its index, not on how the pool is split across threads
+struct Random
+{
+    quint64 state;
+
+    float next()
+    {
+        state = splitMix(state);
+        return (state >> 40) * (1.0f / (1 << 24));
+    }
+};
+
+float bandWidth(const QPair<float, float>& band)
+{
+    float width = band.second - band.first;
+    return width < 0 ? width + 360 : width;
+}
+
+bool sample(const Constraints& constraints, float totalBandWidth, float backgroundLuminance, Random& random, QColor& out)
+{
+    float l = constraints.minLightness + (constraints.maxLightness - constraints.minLightness) * random.next();
+    float h = random.next() * 360;
+    if (!constraints.hueBands.isEmpty()) {
+        // bands are picked by their width
+        float x = random.next() * totalBandWidth;
+        for (const auto& band : constraints.hueBands) {
+            h = band.first + x;
+            x -= bandWidth(band);
+            if (x <= 0) break;
+        }
+        h = std::fmod(h, 360.0f);
+    }
+    // in gamut by construction, the boundary table bounds the chroma
+    float chromaLimit = std::min(constraints.maxChroma, colorspace::maxChroma(l, h));
+    if (chromaLimit < constraints.minChroma) return false;
+
+    float chroma = constraints.minChroma + (chromaLimit - constraints.minChroma) * random.next();
+    auto rgb = colorspace::toSrgb(colorspace::Space::OKLCH, {l, chroma, h});
+    out = QColor::fromRgbF(qBound(0.0f, rgb.x, 1.0f), qBound(0.0f, rgb.y, 1.0f), qBound(0.0f, rgb.z, 1.0f));
+    return constraints.minContrast <= 1 || contrast::ratio(contrast::luminance(out), backgroundLuminance) >= constraints.minContrast;
+}
+} // namespace
+
+QVector<QColor> generate(const Constraints& constraints, const QVector<QColor>& anchors)
+{
+    if (constraints.count <= 0) return {};
+
+    float totalBandWidth = 0;
+    for (const auto& band : constraints.hueBands) {
+        totalBandWidth += bandWidth(band);
+    }
+    const float backgroundLuminance = contrast::luminance(constraints.background);
+
+    // random candidates meeting the per color constraints, slots without one stay invalid
+    const int poolSize = std::max(4096, constraints.count * 128);
+    QVector<QColor> pool(poolSize);
+    QColor* slots = pool.data();
+    parallelFor(poolSize, 256, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            Random random{splitMix(quint64(constraints.seed) << 32 | quint32(i))};
+            for (int attempt = 0; attempt < 8; ++attempt) {
+                if (sample(constraints, totalBandWidth, backgroundLuminance, random, slots[i])) break;
+                slots[i] = QColor();
+            }
+        }
+    });
+    pool.erase(std::remove_if(pool.begin(), pool.end(), [](const QColor& color) { return !color.isValid(); }), pool.end());
+
+    // farthest point selection, each candidate keeps its distance to the nearest anchor or taken color
+    const auto metric = constraints.metric;
+    const auto candidates = colordiff::prepare(metric, pool);
+    const auto fixed = colordiff::prepare(metric, anchors);
+    const int count = candidates.size();
+    std::vector<float> nearest(count, std::numeric_limits<float>::max());
+    auto update = [&](const colorspace::Vec3* taken, int takenCount) {
+        parallelFor(count, 512, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                for (int j = 0; j < takenCount; ++j) {
+                    nearest[i] = std::min(nearest[i], colordiff::distance(metric, taken[j], candidates[i]));
+                }
+            }
+        });
+    };
+    update(fixed.constData(), fixed.size());
+
+    QVector<QColor> colors;
+    while (colors.size() < constraints.count && count > 0) {
+        int best = std::max_element(nearest.begin(), nearest.end()) - nearest.begin();
+        if (nearest[best] < constraints.minDistance) break;
+
+        colors.append(pool[best]);
+        nearest[best] = -1;
+        update(&candidates[best], 1);
+    }
+    return colors;
+}
+} // namespace palettegen
+
+//-------------------------------------------------- tonal ramp --------------------------------------------------
+namespace tonalramp
+{
+void generate(const Scale& scale, const colorspace::Vec3* rgb, int count, colorspace::Vec3* oklch)
+{
+    const int steps = scale.steps.size();
+    if (steps == 0 || count <= 0) return;
+
+    std::vector<colorspace::Vec3> base(count);
+    colorspace::fromSrgb(colorspace::Space::OKLCH, rgb, base.data(), count);
+
+    // lightness per step is shared by every ramp
+    std::vector<float> lightness(steps);
+    const float first = scale.steps.first();
+    const float range = scale.steps.last() - first;
+    for (int s = 0; s < steps; ++s) {
+        float t = range == 0 ? 0 : (scale.steps[s] - first) / range;
+        lightness[s] = scale.lightest + (scale.darkest - scale.lightest) * t;
+    }
+
+    // chroma and hue are kept, the gamut mapping tapers the chroma toward white and black
+    for (int i = 0; i < count; ++i) {
+        for (int s = 0; s < steps; ++s) {
+            oklch[i * steps + s] = {lightness[s], base[i].y, base[i].z};
+        }
+    }
+    colorspace::mapToGamut(colorspace::Space::OKLCH, oklch, oklch, count * steps, scale.mapping);
+}
+
+QVector<QColor> generate(const Scale& scale, const QColor& color)
+{
+    const int steps = scale.steps.size();
+    colorspace::Vec3 rgb = {float(color.redF()), float(color.greenF()), float(color.blueF())};
+    std::vector<colorspace::Vec3> ramp(steps);
+    generate(scale, &rgb, 1, ramp.data());
+    colorspace::toSrgb(colorspace::Space::OKLCH, ramp.data(), ramp.data(), steps);
+
+    QVector<QColor> colors(steps);
+    for (int s = 0; s < steps; ++s) {
+        colors[s] = QColor::fromRgbF(qBound(0.0f, ramp[s].x, 1.0f), qBound(0.0f, ramp[s].y, 1.0f), qBound(0.0f, ramp[s].z, 1.0f));
+    }
+    return colors;
+}
+
+namespace
+{
+// #rrggbb, translucent colors keep their alpha as rgba() in css and #rrggbbaa in design tokens
+QString tokenValue(const QColor& color, bool css)
+{
+    if (color.alpha() == 255) return color.name();
+    if (css) {
+        return QString("rgba(%1, %2, %3, %4)").arg(color.red()).arg(color.green()).arg(color.blue()).arg(color.alphaF(), 0, 'f', 3);
+    }
+    return color.name() + QString("%1").arg(color.alpha(), 2, 16, QChar('0'));
+}
+} // namespace
+
+bool exportTokens(const QString& fileName, const Scale& scale, const QStringList& names, const QVector<QColor>& colors)
+{
+    const int steps = scale.steps.size();
+    if (colors.size() != names.size() * steps) return false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "tonalramp::exportTokens: can't write" << fileName;
+        return false;
+    }
+
+    if (QFileInfo(fileName).suffix().compare("css", Qt::CaseInsensitive) == 0) {
+        QString css = ":root {\n";
+        for (int i = 0; i < names.size(); ++i) {
+            for (int s = 0; s < steps; ++s) {
+                css += QString("  --%1-%2: %3;\n").arg(names[i]).arg(scale.steps[s]).arg(tokenValue(colors[i * steps + s], true));
+            }
+        }
+        css += "}\n";
+        return file.write(css.toUtf8()) >= 0;
+    }
+
+    QJsonObject tokens;
+    for (int i = 0; i < names.size(); ++i) {
+        QJsonObject ramp;
+        for (int s = 0; s < steps; ++s) {
+            const QString value = tokenValue(colors[i * steps + s], false);
+            ramp.insert(QString::number(scale.steps[s]), QJsonObject{{"$type", "color"}, {"$value", value}});
+        }
+        tokens.insert(names[i], ramp);
+    }
+    return file.write(QJsonDocument(tokens).toJson()) >= 0;
+}
+} // namespace tonalramp
+
+//-------------------------------------------------- colormap --------------------------------------------------
+namespace colormap
+{
+void build(const QVector<QColor>& anchors, Kind kind, colorspace::Space space, colorspace::Vec3* rgb, int size,
+           colorspace::GamutMapping mapping)
+{
+    const int n = anchors.size();
+    if (n == 0 || size <= 0) return;
+
+    std::vector<colorspace::Vec3> points(n);
+    for (int i = 0; i < n; ++i) {
+        points[i] = {float(anchors[i].redF()), float(anchors[i].greenF()), float(anchors[i].blueF())};
+    }
+    colorspace::fromSrgb(space, points.data(), points.data(), n);
+
+    // dense polyline through the anchors, resampled by its length below
+    const int dense = std::max(size * 4, 1024);
+    const bool polar = colorspace::isPolar(space);
+    std::vector<colorspace::Vec3> curve(dense);
+    for (int k = 0; k < dense; ++k) {
+        float t = n == 1 ? 0 : float(k) / (dense - 1) * (n - 1);
+        int segment = std::min(int(t), std::max(n - 2, 0));
+        float f = t - segment;
+        const auto& a = points[segment];
+        const auto& b = points[std::min(segment + 1, n - 1)];
+        auto& out = curve[k];
+        out.x = a.x + (b.x - a.x) * f;
+        out.y = a.y + (b.y - a.y) * f;
+        if (polar) {
+            // shortest way around the hue circle
+            float dh = std::fmod(b.z - a.z + 540.0f, 360.0f) - 180.0f;
+            out.z = std::fmod(a.z + dh * f + 360.0f, 360.0f);
+        }
+        else {
+            out.z = a.z + (b.z - a.z) * f;
+        }
+    }
+    colorspace::mapToGamut(space, curve.data(), curve.data(), dense, mapping);
+    std::vector<colorspace::Vec3> curveRgb(dense);
+    colorspace::toSrgb(space, curve.data(), curveRgb.data(), dense);
+    // length is measured on the displayed colors
+    colorspace::fromSrgb(colorspace::Space::OKLab, curveRgb.data(), curve.data(), dense);
+    std::vector<float> length(dense, 0);
+    for (int k = 1; k < dense; ++k) {
+        float dx = curve[k].x - curve[k - 1].x;
+        float dy = curve[k].y - curve[k - 1].y;
+        float dz = curve[k].z - curve[k - 1].z;
+        length[k] = length[k - 1] + std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    const int middle = (dense - 1) / 2;
+    const float total = length.back();
+    int k = 0;
+    for (int j = 0; j < size; ++j) {
+        float u = size == 1 ? 0 : float(j) / (size - 1);
+        float target;
+        if (total <= 0) {
+            target = u;
+        }
+        else if (kind == Kind::Diverging) {
+            target = u <= 0.5f ? length[middle] * u * 2 : length[middle] + (total - length[middle]) * (u - 0.5f) * 2;
+        }
+        else {
+            target = total * u;
+        }
+
+        colorspace::Vec3 value;
+        if (total <= 0) {
+            value = curveRgb[std::min(int(u * (dense - 1) + 0.5f), dense - 1)];
+        }
+        else {
+            // targets only grow, the walk over the polyline is shared by every entry
+            while (k < dense - 2 && length[k + 1] < target) ++k;
+            float span = length[k + 1] - length[k];
+            float f = span > 0 ? qBound(0.0f, (target - length[k]) / span, 1.0f) : 0;
+            const auto& a = curveRgb[k];
+            const auto& b = curveRgb[k + 1];
+            value = {a.x + (b.x - a.x) * f, a.y + (b.y - a.y) * f, a.z + (b.z - a.z) * f};
+        }
+        rgb[j] = {qBound(0.0f, value.x, 1.0f), qBound(0.0f, value.y, 1.0f), qBound(0.0f, value.z, 1.0f)};
+    }
+}
+
+QVector<QColor> build(const QVector<QColor>& anchors, Kind kind, int size, colorspace::Space space)
+{
+    std::vector<colorspace::Vec3> rgb(std::max(size, 0));
+    build(anchors, kind, space, rgb.data(), size);
+    QVector<QColor> colors(rgb.size());
+    for (size_t i = 0; i < rgb.size(); ++i) {
+        colors[i] = QColor::fromRgbF(rgb[i].x, rgb[i].y, rgb[i].z);
+    }
+    return colors;
+}
+
+void uniformity(colordiff::Metric metric, const colorspace::Vec3* rgb, int size, float* out)
+{
+    if (size < 2) return;
+
+    std::vector<colorspace::Vec3> prepared(size);
+    colorspace::fromSrgb(colordiff::spaceOf(metric), rgb, prepared.data(), size);
+    parallelFor(size - 1, 1024, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            out[i] = colordiff::distance(metric, prepared[i], prepared[i + 1]);
+        }
+    });
+}
+
+bool exportLut(const QString& fileName, const colorspace::Vec3* rgb, int size)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qWarning() << "colormap::exportLut: can't write" << fileName;
+        return false;
+    }
+
+    QByteArray data;
+    const bool cube = QFileInfo(fileName).suffix().compare("cube", Qt::CaseInsensitive) == 0;
+    if (cube) {
+        data += "LUT_1D_SIZE " + QByteArray::number(size) + "\n";
+    }
+    for (int i = 0; i < size; ++i) {
+        if (cube) {
+            data += QByteArray::number(rgb[i].x, 'f', 6) + ' ' + QByteArray::number(rgb[i].y, 'f', 6) + ' ' +
+                    QByteArray::number(rgb[i].z, 'f', 6) + '\n';
+        }
+        else {
+            data += QByteArray::number(qRound(rgb[i].x * 255)) + ' ' + QByteArray::number(qRound(rgb[i].y * 255)) + ' ' +
+                    QByteArray::number(qRound(rgb[i].z * 255)) + '\n';
+        }
+    }
+    return file.write(data) == data.size();
+}
+} // namespace colormap
+
+//-------------------------------------------------- harmony search --------------------------------------------
+namespace
+{
+colorspace::Vec3 hsvToRgb(const colorcombo::HsvF& color)
+{
+    float h = (color.h - std::floor(color.h)) * 6;
+    int i = std::min(int(h), 5);
+    float f = h - i;
+    float v = color.v;
+    float p = v * (1 - color.s);
+    float q = v * (1 - color.s * f);
+    float t = v * (1 - color.s * (1 - f));
+    switch (i) {
+        case 0: return {v, t, p};
+        case 1: return {q, v, p};
+        case 2: return {p, v, t};
+        case 3: return {p, q, v};
+        case 4: return {t, p, v};
+        default: return {v, p, q};
+    }
+}
+
+// points bucketed in a uniform grid, a nearest query visits shells of cells around the query until no closer cell is left
+class PointGrid
+{
+public:
+    explicit PointGrid(const QVector<colorspace::Vec3>& points)
+        : m_points(points)
+    {
+        if (points.isEmpty()) return;
+
+        m_min = m_max = points[0];
+        for (const auto& point : points) {
+            for (int c = 0; c < 3; ++c) {
+                m_min[c] = std::min(m_min[c], point[c]);
+                m_max[c] = std::max(m_max[c], point[c]);
+            }
+        }
+        // about two points per cell
+        int cells = std::max(1, int(std::cbrt(points.size() / 2.0f)));
+        float extent = std::max({m_max.x - m_min.x, m_max.y - m_min.y, m_max.z - m_min.z});
+        m_cell = std::max(extent / cells, 1e-4f);
+        for (int c = 0; c < 3; ++c) {
+            m_dims[c] = std::min(int((m_max[c] - m_min[c]) / m_cell), cells) + 1;
+        }
+
+        // counting sort of the point indexes by cell
+        std::vector<int> cellOf(points.size());
+        m_starts.assign(m_dims[0] * m_dims[1] * m_dims[2] + 1, 0);
+        for (int i = 0; i < points.size(); ++i) {
+            cellOf[i] = cellIndex(points[i]);
+            ++m_starts[cellOf[i] + 1];
+        }
+        for (size_t i = 1; i < m_starts.size(); ++i) {
+            m_starts[i] += m_starts[i - 1];
+        }
+        m_indexes.resize(points.size());
+        std::vector<int> fill(m_starts.begin(), m_starts.end() - 1);
+        for (int i = 0; i < points.size(); ++i) {
+            m_indexes[fill[cellOf[i]]++] = i;
+        }
+    }
+
+    float nearest(const colorspace::Vec3& point) const
+    {
+        if (m_points.isEmpty()) return std::numeric_limits<float>::max();
+
+        int center[3];
+        for (int c = 0; c < 3; ++c) {
+            center[c] = coordinate(point, c);
+        }
+        const int maxShell = std::max({m_dims[0], m_dims[1], m_dims[2]});
+        float best = std::numeric_limits<float>::max();
+        for (int r = 0; r < maxShell; ++r) {
+            for (int x = std::max(center[0] - r, 0); x <= std::min(center[0] + r, m_dims[0] - 1); ++x) {
+                for (int y = std::max(center[1] - r, 0); y <= std::min(center[1] + r, m_dims[1] - 1); ++y) {
+                    for (int z = std::max(center[2] - r, 0); z <= std::min(center[2] + r, m_dims[2] - 1); ++z) {
+                        // only the shell, the inside was visited before
+                        if (std::max({std::abs(x - center[0]), std::abs(y - center[1]), std::abs(z - center[2])}) != r) continue;
+                        int cell = (x * m_dims[1] + y) * m_dims[2] + z;
+                        for (int i = m_starts[cell]; i < m_starts[cell + 1]; ++i) {
+                            const auto& other = m_points[m_indexes[i]];
+                            float dx = point.x - other.x;
+                            float dy = point.y - other.y;
+                            float dz = point.z - other.z;
+                            best = std::min(best, dx * dx + dy * dy + dz * dz);
+                        }
+                    }
+                }
+            }
+            // cells beyond this shell are at least r cells away
+            float bound = r * m_cell;
+            if (best <= bound * bound) break;
+        }
+        return std::sqrt(best);
+    }
+
+private:
+    int coordinate(const colorspace::Vec3& point, int c) const
+    {
+        return qBound(0, int((point[c] - m_min[c]) / m_cell), m_dims[c] - 1);
+    }
+
+    int cellIndex(const colorspace::Vec3& point) const
+    {
+        return (coordinate(point, 0) * m_dims[1] + coordinate(point, 1)) * m_dims[2] + coordinate(point, 2);
+    }
+
+    QVector<colorspace::Vec3> m_points;
+    colorspace::Vec3 m_min = {0, 0, 0};
+    colorspace::Vec3 m_max = {0, 0, 0};
+    float m_cell = 1;
+    int m_dims[3] = {1, 1, 1};
+    std::vector<int> m_starts;
+    std::vector<int> m_indexes;
+};
+
+// shared by the jobs of one start(), it outlives a cancelled search until its last job returns
+struct SearchState
+{
+    explicit SearchState(const QVector<colorspace::Vec3>& palette)
+        : grid(palette)
+    {
+    }
+
+    PointGrid grid;
+    colorcombo::HsvF base;
+    std::atomic<bool> cancelled{false};
+    // jobs inside search() under mutex, cancel() sleeps on idle until it is 0 so combinations can be deleted after it
+    int running = 0;
+    QWaitCondition idle;
+    // worst kept distance once the result list is full, steps that can't beat it stop early
+    std::atomic<float> worst{std::numeric_limits<float>::max()};
+    QMutex mutex;
+    HarmonySearch* owner = nullptr;
+};
+
+class SearchJob : public QRunnable
+{
+public:
+    SearchJob(const std::shared_ptr<SearchState>& state, colorcombo::ICombination* combination, int steps,
+              const std::function<void(const HarmonySearch::Suggestion&)>& ready)
+        : m_state(state)
+        , m_combination(combination)
+        , m_min(combination->min())
+        , m_max(combination->max())
+        , m_value(combination->getValue())
+        , m_steps(combination->rangeEnabled() ? std::max(steps, 2) : 1)
+        , m_ready(ready)
+    {
+    }
+
+    void run() override
+    {
+        {
+            QMutexLocker locker(&m_state->mutex);
+            if (m_state->cancelled) return;
+            ++m_state->running;
+        }
+        search();
+        QMutexLocker locker(&m_state->mutex);
+        if (--m_state->running == 0) m_state->idle.wakeAll();
+    }
+
+private:
+    // the combination is only used while running is counted, cancel() waits for it
+    void search()
+    {
+        if (m_state->cancelled) return;
+
+        const int n = m_combination->colorCount();
+        std::vector<colorcombo::HsvF> generated(n);
+        std::vector<colorspace::Vec3> rgb(n);
+        std::vector<colorspace::Vec3> lab(n);
+        HarmonySearch::Suggestion best = {m_combination, m_value, std::numeric_limits<float>::max()};
+        for (int step = 0; step < m_steps; ++step) {
+            if (m_state->cancelled) return;
+
+            double value = m_steps == 1 ? m_value : m_min + (m_max - m_min) * step / (m_steps - 1);
+            m_combination->genColors(&m_state->base, 1, value, generated.data());
+            for (int i = 0; i < n; ++i) {
+                rgb[i] = hsvToRgb(generated[i]);
+            }
+            colorspace::fromSrgb(colorspace::Space::OKLab, rgb.data(), lab.data(), n);
+
+            // the sum only grows, stop once the mean can't beat the best so far
+            const float limit = std::min(best.distance, m_state->worst.load()) * n;
+            float sum = 0;
+            int i = 0;
+            for (; i < n && sum < limit; ++i) {
+                sum += m_state->grid.nearest(lab[i]);
+            }
+            if (i == n && sum < limit) best = {m_combination, value, sum / n};
+        }
+
+        // post under lock, owner can't be destroyed before the event is queued, see cancel()
+        QMutexLocker locker(&m_state->mutex);
+        if (!m_state->owner) return;
+        auto ready = m_ready;
+        QMetaObject::invokeMethod(m_state->owner, [ready, best]() { ready(best); }, Qt::QueuedConnection);
+    }
+
+    std::shared_ptr<SearchState> m_state;
+    colorcombo::ICombination* m_combination;
+    double m_min;
+    double m_max;
+    double m_value;
+    int m_steps;
+    std::function<void(const HarmonySearch::Suggestion&)> m_ready;
+};
+} // namespace
+
+class HarmonySearch::Private
+{
+public:
+    std::shared_ptr<SearchState> state;
+    QVector<Suggestion> suggestions;
+    int limit = 10;
+    int pending = 0;
+
+    // true if the list changed
+    bool merge(const Suggestion& suggestion)
+    {
+        if (suggestion.distance == std::numeric_limits<float>::max()) return false;
+        if (suggestions.size() == limit && suggestion.distance >= suggestions.back().distance) return false;
+
+        auto it = std::upper_bound(suggestions.begin(), suggestions.end(), suggestion,
+                                   [](const Suggestion& a, const Suggestion& b) { return a.distance < b.distance; });
+        suggestions.insert(it, suggestion);
+        if (suggestions.size() > limit) suggestions.removeLast();
+        if (suggestions.size() == limit) state->worst = suggestions.back().distance;
+        return true;
+    }
+};
+
+HarmonySearch::HarmonySearch(QObject* parent)
+    : QObject(parent)
+    , p(new Private)
+{
+}
+
+HarmonySearch::~HarmonySearch()
+{
+    cancel();
+}
+
+void HarmonySearch::start(const QColor& color, const QVector<QColor>& palette, const QVector<colorcombo::ICombination*>& combinations,
+                          int steps, int limit)
+{
+    cancel();
+    p->suggestions.clear();
+    p->limit = std::max(limit, 1);
+    p->state = std::make_shared<SearchState>(colordiff::prepare(colordiff::Metric::OK, palette));
+    p->state->base = {float(std::max(color.hsvHueF(), 0.0)), float(color.hsvSaturationF()), float(color.valueF())};
+    p->state->owner = this;
+
+    auto state = p->state;
+    auto ready = [this, state](const Suggestion& suggestion) {
+        if (state != p->state) return;
+        bool changed = p->merge(suggestion);
+        --p->pending;
+        if (changed) emit suggestionsChanged();
+        if (p->pending == 0) emit finished();
+    };
+
+    p->pending = 0;
+    for (auto combination : combinations) {
+        if (combination->colorCount() == 0) continue;
+        ++p->pending;
+        QThreadPool::globalInstance()->start(new SearchJob(state, combination, steps, ready));
+    }
+
+    if (!p->suggestions.isEmpty()) emit suggestionsChanged();
+    if (p->pending == 0) emit finished();
+}
+
+void HarmonySearch::cancel()
+{
+    if (!p->state) return;
+
+    auto state = p->state;
+    {
+        QMutexLocker locker(&state->mutex);
+        state->cancelled = true;
+        state->owner = nullptr;
+        // jobs check cancelled every step, so this sleeps for one step at most
+        while (state->running > 0) {
+            state->idle.wait(&state->mutex);
+        }
+    }
+    // results already queued see another state and are dropped
+    p->state.reset();
+    p->pending = 0;
+}
+
+bool HarmonySearch::isRunning() const
+{
+    return p->pending > 0;
+}
+
+QVector<HarmonySearch::Suggestion> HarmonySearch::suggestions() const
+{
+    return p->suggestions;
+}
+
+//--------------------------------------------------- color slider -------------------------------------------
+MixedSpinBox::MixedSpinBox(QWidget* parent)
+    : QDoubleSpinBox(parent)
+{
+    setObjectName("MixedSpinBox");
+    setDecimals(4);
+    setSingleStep(0.0001);
+    setFocusPolicy(Qt::ClickFocus);
+}
+
+QString MixedSpinBox::textFromValue(double value) const
+{
+    QString shortestNum = QLocale().toString(value, 'f', QLocale::FloatingPointShortest);
+    QString decimalNum = QLocale().toString(value, 'f', decimals());
+    return shortestNum.size() <= decimalNum.size() ? shortestNum : decimalNum;
+}
+
+void MixedSpinBox::keyPressEvent(QKeyEvent* e)
+{
+    if (e->key() == Qt::Key_Return || e->key() == Qt::Key_Enter) {
+        clearFocus();
+    }
+    else {
+        QDoubleSpinBox::keyPressEvent(e);
+    }
+}
+
+class JumpableSlider::Private
+{
+public:
+    double minValue = 0.0;
+    double maxValue = 1.0;
+    double singleStep = 0.0001;
+};
+
+JumpableSlider::JumpableSlider(QWidget* parent)
+    : JumpableSlider(Qt::Horizontal, parent)
+{
+}
+
+JumpableSlider::JumpableSlider(Qt::Orientation orientation, QWidget* parent)
+    : QSlider(orientation, parent)
+    , p(new Private)
+{
+    connect(this, &QSlider::valueChanged, this, [this](int value) { emit valueChanged(value * p->singleStep); });
+}
+
+JumpableSlider::~JumpableSlider() = default;
+
+void JumpableSlider::setValue(double value)
+{
+    // need round
+    // 0.179999 * 1000 need be 180
+    // int(0.179999 * 1000) = 179
+    QSlider::setValue(std::round(value / p->singleStep));
+}
+
+void JumpableSlider::setMinimum(double value)
+{
+    QSlider::setMinimum(value / p->singleStep);
+    p->minValue = value;
+}
+
+void JumpableSlider::setMaximum(double value)
+{
+    if (value < p->minValue) {
+        return;
+    }
+    QSlider::setMaximum(value / p->singleStep);
+    p->maxValue = value;
+}
+
+void JumpableSlider::setRange(double minValue, double maxValue)
+{
+    setMinimum(minValue);
+    setMaximum(maxValue);
+}
+
+void JumpableSlider::setSingleStep(double value)
+{
+    if (value == 0.0) {
+        return;
+    }
+    p->singleStep = value;
+    setMinimum(p->minValue);
+    setMaximum(p->maxValue);
+    setValue(this->value());
+}
+
+double JumpableSlider::value() const
+{
+    return QSlider::value() * p->singleStep;
+}
+
+double JumpableSlider::minimum() const
+{
+    return p->minValue;
+}
+
+double JumpableSlider::maximum() const
+{
+    return p->maxValue;
+}
+
+double JumpableSlider::singleStep() const
+{
+    return p->singleStep;
+}
+
+void JumpableSlider::mousePressEvent(QMouseEvent* e)
+{
+    if (e->button() == Qt::LeftButton) {
+        e->accept();
+        setSliderDown(true);
+        handleMouseEvent(e);
+    }
+    else {
+        QSlider::mousePressEvent(e);
+    }
+}
+
+void JumpableSlider::mouseMoveEvent(QMouseEvent* e)
+{
+    if (e->buttons() & Qt::LeftButton) {
+        e->accept();
+        handleMouseEvent(e);
+    }
+    else {
+        QSlider::mouseMoveEvent(e);
+    }
+}
+
+void JumpableSlider::mouseReleaseEvent(QMouseEvent* e)
+{
+    QSlider::mouseReleaseEvent(e);
+}
+
+void JumpableSlider::handleMouseEvent(QMouseEvent* e)
+{
+    double newVal;
+    double maxValue = maximum();
+    double minValue = minimum();
+    if (orientation() == Qt::Horizontal) {
+        newVal = minValue + ((maxValue - minValue) * e->x()) / width();
+    }
+    else {
+        newVal = minValue + ((maxValue - minValue) * (height() - e->y())) / height();
+    }
+    setValue(!invertedAppearance() ? newVal : maxValue - newVal);
+}
+
+class GradientSlider::Private
+{
+public:
+    ColorCorrectionPtr colorCorrection;
+    QGradientStops stops;
+    ChannelFunction function;
+    // a stop isn't opaque, the strip carries alpha and is drawn over the checkerboard
+    bool translucent = false;
+    // one pixel across, drawn stretched, full size when the correction dithers
+    QImage colorBuffer;
+    QVector<QPair<double, double>> outOfGamut;
+
+    // stops converted into the space once, each call only interpolates
+    static ChannelFunction interpolate(const QGradientStops& stops, Interpolation interpolation)
+    {
+        const int n = stops.size();
+        std::vector<float> positions(n);
+        std::vector<colorspace::Vec3> values(n);
+        for (int i = 0; i < n; ++i) {
+            const QColor& color = stops[i].second;
+            positions[i] = stops[i].first;
+            values[i] = {float(color.redF()), float(color.greenF()), float(color.blueF())};
+            if (interpolation == Interpolation::HSV) {
+                // achromatic colors take the hue of the previous stop
+                float h = color.hsvHueF();
+                values[i] = {h < 0 ? (i > 0 ? values[i - 1].x : 0) : h, float(color.hsvSaturationF()), float(color.valueF())};
+            }
+        }
+        switch (interpolation) {
+            case Interpolation::LinearRGB:
+                for (auto& value : values) {
+                    for (int c = 0; c < 3; ++c) {
+                        value[c] = Transfer<TransferKind::SRGB>::decode(value[c]);
+                    }
+                }
+                break;
+            case Interpolation::OKLab: colorspace::fromSrgb(colorspace::Space::OKLab, values.data(), values.data(), n); break;
+            case Interpolation::OKLCH: colorspace::fromSrgb(colorspace::Space::OKLCH, values.data(), values.data(), n); break;
+            default: break;
+        }
+
+        return [positions, values, interpolation](const float* t, int count, colorspace::Vec3* rgb) {
+            const int n = positions.size();
+            for (int i = 0; i < count; ++i) {
+                int upper = std::upper_bound(positions.begin(), positions.end(), t[i]) - positions.begin();
+                if (upper == 0 || upper == n) {
+                    rgb[i] = values[upper == 0 ? 0 : n - 1];
+                    continue;
+                }
+                const auto& a = values[upper - 1];
+                const auto& b = values[upper];
+                float span = positions[upper] - positions[upper - 1];
+                float f = span > 0 ? (t[i] - positions[upper - 1]) / span : 0;
+                rgb[i] = {a.x + (b.x - a.x) * f, a.y + (b.y - a.y) * f, a.z + (b.z - a.z) * f};
+                if (interpolation == Interpolation::OKLCH) {
+                    float dh = std::fmod(b.z - a.z + 540.0f, 360.0f) - 180.0f;
+                    rgb[i].z = std::fmod(a.z + dh * f + 360.0f, 360.0f);
+                }
+            }
+            switch (interpolation) {
+                case Interpolation::LinearRGB:
+                    for (int i = 0; i < count; ++i) {
+                        for (int c = 0; c < 3; ++c) {
+                            rgb[i][c] = Transfer<TransferKind::SRGB>::encode(rgb[i][c]);
+                        }
+                    }
+                    break;
+                case Interpolation::HSV:
+                    for (int i = 0; i < count; ++i) {
+                        rgb[i] = hsvToRgb({rgb[i].x, rgb[i].y, rgb[i].z});
+                    }
+                    break;
+                case Interpolation::OKLab: colorspace::toSrgb(colorspace::Space::OKLab, rgb, rgb, count); break;
+                case Interpolation::OKLCH: colorspace::toSrgb(colorspace::Space::OKLCH, rgb, rgb, count); break;
+                default: break;
+            }
+        };
+    }
+
+    void render(GradientSlider* slider)
+    {
+        if (!function) return;
+
+        // render in worker thread with copies of the current state, buffer is swapped when ready
+        const bool horizontal = slider->orientation() == Qt::Horizontal;
+        const int length = horizontal ? slider->width() : slider->height();
+        // a stretched dither pattern would show as stripes, so it is rendered at its real size
+        const bool dithered = colorCorrection && (colorCorrection->dither() != Dither::None ||
+                                                  colorCorrection->precision() == RenderPrecision::Int16);
+        const int thickness = dithered ? (horizontal ? slider->height() : slider->width()) : 1;
+        const bool inverted = slider->invertedAppearance();
+        const ChannelFunction sliderFunction = function;
+        const QGradientStops alphaStops = translucent ? stops : QGradientStops();
+        const ColorCorrectionPtr correction = colorCorrection;
+        RenderScheduler::instance()->submit(
+            slider, [=]() { return render(length, thickness, horizontal, inverted, sliderFunction, alphaStops, correction.get()); },
+            [this, slider](const QImage& image) {
+                colorBuffer = image;
+                slider->update();
+            });
+    }
+
+    static QImage render(int length, int thickness, bool horizontal, bool inverted, const ChannelFunction& function,
+                         const QGradientStops& alphaStops, const ColorCorrection* colorCorrection)
+    {
+        length = std::max(length, 1);
+        thickness = std::max(thickness, 1);
+        // pixel centers, the maximum is at the top of a vertical slider
+        std::vector<float> positions(length);
+        for (int i = 0; i < length; ++i) {
+            float t = (i + 0.5f) / length;
+            positions[i] = horizontal != inverted ? t : 1 - t;
+        }
+        std::vector<colorspace::Vec3> rgb(length);
+        function(positions.data(), length, rgb.data());
+        // alpha of the stops, linear in position whatever the color interpolation
+        std::vector<float> alpha(length, 1.0f);
+        if (!alphaStops.isEmpty()) {
+            const int n = alphaStops.size();
+            for (int i = 0; i < length; ++i) {
+                const float t = positions[i];
+                int upper = std::upper_bound(alphaStops.begin(), alphaStops.end(), t,
+                                             [](float value, const QGradientStop& stop) { return value < stop.first; }) -
+                            alphaStops.begin();
+                if (upper == 0 || upper == n) {
+                    alpha[i] = alphaStops[upper == 0 ? 0 : n - 1].second.alphaF();
+                    continue;
+                }
+                const auto& from = alphaStops[upper - 1];
+                const auto& to = alphaStops[upper];
+                const float span = to.first - from.first;
+                const float f = span > 0 ? (t - from.first) / span : 0;
+                alpha[i] = from.second.alphaF() + (to.second.alphaF() - from.second.alphaF()) * f;
+            }
+        }
+
+        QImage colorBuffer(horizontal ? QSize(length, thickness) : QSize(thickness, length),
+                           colorCorrection ? colorCorrection->renderFormat() : QImage::Format_ARGB32);
+        uchar* bits = colorBuffer.bits();
+        const int pixelSize = colorBuffer.depth() / 8;
+        const int step = horizontal ? pixelSize : colorBuffer.bytesPerLine();
+        const int across = horizontal ? colorBuffer.bytesPerLine() : pixelSize;
+        for (int i = 0; i < length; ++i) {
+            const float r = qBound(0.0f, rgb[i].x, 1.0f);
+            const float g = qBound(0.0f, rgb[i].y, 1.0f);
+            const float b = qBound(0.0f, rgb[i].z, 1.0f);
+            const float a = qBound(0.0f, alpha[i], 1.0f);
+            for (int j = 0; j < thickness; ++j) {
+                uchar* pixel = bits + i * step + j * across;
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 12, 0))
+                if (colorBuffer.format() == QImage::Format_RGBA64) {
+                    *reinterpret_cast<QRgba64*>(pixel) =
+                        QRgba64::fromRgba64(qRound(r * 65535), qRound(g * 65535), qRound(b * 65535), qRound(a * 65535));
+                    continue;
+                }
+#endif
+                *reinterpret_cast<QRgb*>(pixel) = qRgba(qRound(r * 255), qRound(g * 255), qRound(b * 255), qRound(a * 255));
+            }
+        }
+        // color correction, only one pixel per position unless dithered
+        if (colorCorrection) {
+            colorCorrection->correct(colorBuffer);
+        }
+        return colorBuffer;
+    }
+};
+
+GradientSlider::GradientSlider(QWidget* parent)
+    : JumpableSlider(Qt::Horizontal, parent)
+    , p(new Private)
+{
+}
+
+GradientSlider::~GradientSlider()
+{
+    RenderScheduler::instance()->cancel(this);
+}
+
+void GradientSlider::setGradient(const QColor& startColor, const QColor& stopColor, Interpolation interpolation)
+{
+    setGradient({{0, startColor}, {1, stopColor}}, interpolation);
+}
+
+void GradientSlider::setGradient(const QGradientStops& colors, Interpolation interpolation)
+{
+    if (colors.size() <= 1) {
+        qWarning() << "ColorSlider::setGradient: colors size should >= 2";
+        return;
+    }
+
+    p->stops = colors;
+    p->translucent = std::any_of(colors.begin(), colors.end(), [](const QGradientStop& stop) { return stop.second.alpha() < 255; });
+    p->function = Private::interpolate(colors, interpolation);
+    p->render(this);
+}
+
+void GradientSlider::setChannelFunction(const ChannelFunction& function)
+{
+    p->stops.clear();
+    p->translucent = false;
+    p->function = function;
+    p->render(this);
+}
+
+void GradientSlider::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->render(this);
+}
+
+void GradientSlider::setOutOfGamut(const QVector<QPair<double, double>>& ranges)
+{
+    if (ranges == p->outOfGamut) return;
+
+    p->outOfGamut = ranges;
+    update();
+}
+
+QGradientStops GradientSlider::gradientColor() const
+{
+    if (!p->stops.isEmpty() || !p->function) return p->stops;
+
+    constexpr int count = 17;
+    float positions[count];
+    colorspace::Vec3 rgb[count];
+    for (int i = 0; i < count; ++i) {
+        positions[i] = i / float(count - 1);
+    }
+    p->function(positions, count, rgb);
+    QGradientStops stops;
+    for (int i = 0; i < count; ++i) {
+        stops.append({positions[i], QColor::fromRgbF(qBound(0.0f, rgb[i].x, 1.0f), qBound(0.0f, rgb[i].y, 1.0f),
+                                                     qBound(0.0f, rgb[i].z, 1.0f))});
+    }
+    return stops;
+}
+
+void GradientSlider::paintEvent(QPaintEvent* e)
+{
+    QPainter painter(this);
+    // draw groove, the strip is stretched across
+    if (p->translucent) {
+        painter.fillRect(rect(), checkerboard());
+    }
+    painter.drawImage(rect(), p->colorBuffer);
+    // hatch colors outside of the display gamut
+    for (const auto& range : p->outOfGamut) {
+        double from = invertedAppearance() ? 1 - range.second : range.first;
+        double to = invertedAppearance() ? 1 - range.first : range.second;
+        QRectF rect;
+        if (orientation() == Qt::Horizontal) {
+            rect = QRectF(from * width(), 0, (to - from) * width(), height());
+        }
+        else {
+            rect = QRectF(0, height() - to * height(), width(), (to - from) * height());
+        }
+        painter.fillRect(rect, QBrush(QColor(0, 0, 0, 96), Qt::BDiagPattern));
+    }
+
+    QPointF p1, p2;
+    if (orientation() == Qt::Horizontal) {
+        double pos = (value() - minimum()) / (maximum() - minimum()) * width();
+        p1 = QPointF(pos, 0);
+        p2 = QPointF(pos, height());
+    }
+    else {
+        double pos = height() - (value() - minimum()) / (maximum() - minimum()) * height();
+        p1 = QPointF(0, pos);
+        p2 = QPointF(height(), pos);
+    }
+    // draw handle
+    painter.setPen(QPen(QColor("#5C5C5C"), 6));
+    painter.drawLine(p1, p2);
+}
+
+void GradientSlider::resizeEvent(QResizeEvent* e)
+{
+    p->render(this);
+}
+
+class ColorSpinHSlider::Private
+{
+public:
+    MixedSpinBox* spinbox;
+    GradientSlider* slider;
+
+    Private(const QString& name, QWidget* parent)
+    {
+        QLabel* text = new QLabel(name, parent);
+        text->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+        spinbox = new MixedSpinBox(parent);
+        spinbox->setButtonSymbols(QAbstractSpinBox::NoButtons);
+        slider = new GradientSlider(parent);
+        slider->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+        auto layout = new QHBoxLayout(parent);
+        layout->setAlignment(Qt::AlignLeft);
+        layout->setMargin(0);
+        layout->addWidget(text, 1);
+        layout->addWidget(spinbox, 2);
+        layout->addWidget(slider, 7);
+    }
+};
+ColorSpinHSlider::ColorSpinHSlider(const QString& name, QWidget* parent)
+    : QWidget(parent)
+    , p(new Private(name, this))
+{
+    connect(p->slider, &GradientSlider::valueChanged, this, &ColorSpinHSlider::valueChanged);
+    connect(p->slider, &GradientSlider::valueChanged, p->spinbox, &MixedSpinBox::setValue);
+    connect(p->spinbox, &MixedSpinBox::editingFinished, this, [this]() { p->slider->setValue(p->spinbox->value()); });
+}
+
+ColorSpinHSlider::~ColorSpinHSlider() = default;
+
+void ColorSpinHSlider::setGradient(const QColor& startColor, const QColor& stopColor, GradientSlider::Interpolation interpolation)
+{
+    p->slider->setGradient(startColor, stopColor, interpolation);
+}
+
+void ColorSpinHSlider::setGradient(const QGradientStops& colors, GradientSlider::Interpolation interpolation)
+{
+    p->slider->setGradient(colors, interpolation);
+}
+
+void ColorSpinHSlider::setChannelFunction(const GradientSlider::ChannelFunction& function)
+{
+    p->slider->setChannelFunction(function);
+}
+
+void ColorSpinHSlider::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    p->slider->setColorCorrection(colorCorrection);
+}
+
+void ColorSpinHSlider::setOutOfGamut(const QVector<QPair<double, double>>& ranges)
+{
+    p->slider->setOutOfGamut(ranges);
+}
+
+void ColorSpinHSlider::setValue(double value)
+{
+    p->spinbox->setValue(value);
+    p->slider->setValue(value);
+}
+
+void ColorSpinHSlider::setRange(double min, double max)
+{
+    p->slider->setRange(min, max);
+    p->spinbox->setRange(min, max);
+}
+
+QGradientStops ColorSpinHSlider::gradientColor() const
+{
+    return p->slider->gradientColor();
+}
+
+double ColorSpinHSlider::value() const
+{
+    return p->slider->value();
+}
+
+//--------------------------------------------- color button -------------------------------------------------------
+class ColorButton::Private
+{
+public:
+    QPoint pressPos;
+    QColor color;
+    ColorCorrectionPtr colorCorrection;
+    int bolderTopWidth = 0;
+    int bolderBottomWidth = 0;
+    int bolderLeftWidth = 0;
+    int bolderRightWidth = 0;
+
+    void updateStyle(QPushButton* btn)
+    {
+        QColor showColor = color;
+        if (colorCorrection) {
+            colorCorrection->correct(showColor);
+        }
+
+        // translucent colors are composited by the style over the checkerboard painted first
+        const QString background = showColor.alpha() < 255 ? QString("rgba(%1,%2,%3,%4)")
+                                                                   .arg(showColor.red())
+                                                                   .arg(showColor.green())
+                                                                   .arg(showColor.blue())
+                                                                   .arg(showColor.alpha())
+                                                             : showColor.name();
+        int minWidth = DPI(20);
+        int minHeight = DPI(20);
+        auto style = QString("QPushButton{min-width:%1px;min-height:%2px;background-color:%3;"
+                             "border-top:%4px solid;border-bottom:%5px solid;"
+                             "border-left:%6px solid;border-right:%7px solid;}"
+                             "QPushButton:pressed{border: 1px solid #ffd700;}")
+                         .arg(minWidth)
+                         .arg(minHeight)
+                         .arg(background)
+                         .arg(bolderTopWidth)
+                         .arg(bolderBottomWidth)
+                         .arg(bolderLeftWidth)
+                         .arg(bolderRightWidth);
+        btn->setStyleSheet(style);
+    }
+};
+
+ColorButton::ColorButton(QWidget* parent)
+    : QPushButton(parent)
+    , p(new Private)
+{
+    setAcceptDrops(true);
+    connect(this, &QPushButton::clicked, this, [this]() { emit colorClicked(p->color); });
+}
+
+ColorButton::~ColorButton() = default;
+
+void ColorButton::setColor(const QColor& color)
+{
+    p->color = color;
+    p->updateStyle(this);
+}
+
+void ColorButton::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->updateStyle(this);
+}
+
+void ColorButton::setBolderWidth(int top, int bottom, int left, int right)
+{
+    p->bolderTopWidth = top;
+    p->bolderBottomWidth = bottom;
+    p->bolderLeftWidth = left;
+    p->bolderRightWidth = right;
+    p->updateStyle(this);
+}
+
+QColor ColorButton::color() const
+{
+    return p->color;
+}
+
+void ColorButton::mousePressEvent(QMouseEvent* e)
+{
+    p->pressPos = e->pos();
+    QPushButton::mousePressEvent(e);
+}
+
+void ColorButton::mouseMoveEvent(QMouseEvent* e)
+{
+    if (e->buttons() & Qt::LeftButton) {
+        if ((p->pressPos - e->pos()).manhattanLength() > QApplication::startDragDistance()) {
+            QMimeData* mime = new QMimeData;
+            mime->setColorData(p->color);
+            QDrag* drg = new QDrag(this);
+            drg->setMimeData(mime);
+            drg->setPixmap(swatchPixmap(size(), p->color));
+            drg->exec(Qt::CopyAction);
+            // need let pushbutton release
+            QMouseEvent event(QEvent::MouseButtonRelease, e->pos(), Qt::LeftButton, Qt::LeftButton, 0);
+            QApplication::sendEvent(this, &event);
+        }
+    }
+}
+
+void ColorButton::dragEnterEvent(QDragEnterEvent* e)
+{
+    if (qvariant_cast<QColor>(e->mimeData()->colorData()).isValid())
+        e->accept();
+    else
+        e->ignore();
+}
+
+void ColorButton::dragLeaveEvent(QDragLeaveEvent*)
+{
+    if (hasFocus()) parentWidget()->setFocus();
+}
+
+void ColorButton::dropEvent(QDropEvent* e)
+{
+    auto color = qvariant_cast<QColor>(e->mimeData()->colorData());
+    if (color.isValid()) {
+        setColor(color);
+        emit colorDroped(color);
+        e->accept();
+    }
+    else {
+        e->ignore();
+    }
+}
+
+void ColorButton::paintEvent(QPaintEvent* e)
+{
+    if (p->color.alpha() < 255) {
+        QPainter painter(this);
+        painter.fillRect(rect(), checkerboard());
+    }
+    QPushButton::paintEvent(e);
+}
+
+//--------------------------------------------- color palette ------------------------------------------------------
+class ColorPalette::Private
+{
+public:
+    int columnCount = 0;
+    QGridLayout* layout = nullptr;
+    ColorCorrectionPtr colorCorrection;
+    QVector<QColor> colors;
+    // colors prepared for colordiff, dropped whenever colors change
+    mutable QVector<colorspace::Vec3> prepared;
+    mutable colorspace::Space preparedSpace = colorspace::Space::CIELab;
+    // WCAG luminance per color, kept in step with colors
+    QVector<float> luminances;
+
+    Private(int column, QScrollArea* parent)
+    {
+        columnCount = column;
+
+        auto scrollWidget = new QWidget(parent);
+        layout = new QGridLayout(scrollWidget);
+        layout->setAlignment(Qt::AlignTop);
+        layout->setSpacing(0);
+        layout->setMargin(0);
+
+        parent->setWidget(scrollWidget);
+    }
+
+    std::pair<int, int> getLayoutIndex(int index) { return {index / columnCount, index % columnCount}; }
+
+    const QVector<colorspace::Vec3>& preparedColors(colordiff::Metric metric) const
+    {
+        auto space = colordiff::spaceOf(metric);
+        if (prepared.size() != colors.size() || preparedSpace != space) {
+            prepared = colordiff::prepare(metric, colors);
+            preparedSpace = space;
+        }
+        return prepared;
+    }
+
+    void updateLayout(int begin, int end)
+    {
+        for (int i = begin; i < end; ++i) {
+            int row = i / columnCount;
+            int col = i % columnCount;
+            auto btn = qobject_cast<ColorButton*>(layout->itemAtPosition(row, col)->widget());
+            btn->setColor(colors[i]);
+        }
+    }
+
+    void updateBolder(int begin, int end)
+    {
+        int size = colors.size();
+        for (int i = begin; i < end; ++i) {
+            int row = i / columnCount;
+            int col = i % columnCount;
+            auto btn = qobject_cast<ColorButton*>(layout->itemAtPosition(row, col)->widget());
+            int bolderLeftWidth = col == 0 ? 1 : 0;
+            int bolderTopWidth = row == 0 ? 1 : 0;
+            btn->setBolderWidth(bolderTopWidth, 1, bolderLeftWidth, 1);
+        }
+    }
+};
+
+ColorPalette::ColorPalette(int column, QWidget* parent)
+    : QScrollArea(parent)
+    , p(new Private(column, this))
+{
+    setWidgetResizable(true);
+    setAcceptDrops(true);
+}
+
+ColorPalette::~ColorPalette() = default;
+
+void ColorPalette::addColor(const QColor& color)
+{
+    int index = p->colors.size();
+    p->colors.push_back(color);
+    p->luminances.push_back(contrast::luminance(color));
+
+    auto btn = new ColorButton(this);
+    btn->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
+    btn->setToolTip(tr("Ctrl + click to remove color"));
+    btn->setColorCorrection(p->colorCorrection);
+    connect(btn, &ColorButton::colorClicked, this, [this, index](const QColor& color) {
+        if (QApplication::keyboardModifiers() == Qt::ControlModifier) {
+            auto layoutIndex = p->getLayoutIndex(index);
+            removeColor(layoutIndex.first, layoutIndex.second);
+        }
+        else {
+            emit colorClicked(color);
+        }
+    });
+    connect(btn, &ColorButton::colorDroped, this, [this, index](const QColor& color) {
+        // update color at index
+        p->colors[index] = color;
+        p->luminances[index] = contrast::luminance(color);
+        p->prepared.clear();
+        emit colorsChanged();
+    });
+
+    auto layoutIndex = p->getLayoutIndex(index);
+    p->layout->addWidget(btn, layoutIndex.first, layoutIndex.second);
+
+    p->updateLayout(index, p->colors.size());
+    p->updateBolder(index, p->colors.size());
+    emit colorsChanged();
+}
+
+void ColorPalette::setColor(const QColor& color, int row, int column)
+{
+    int index = row * p->columnCount + column;
+    p->colors[index] = color;
+    p->luminances[index] = contrast::luminance(color);
+    p->prepared.clear();
+    p->updateLayout(index, index + 1);
+    emit colorsChanged();
+}
+
+void ColorPalette::removeColor(int row, int column)
+{
+    int size = p->colors.size();
+    auto item = p->layout->takeAt(size - 1);
+    if (item->widget()) {
+        delete item->widget();
+    }
+    delete item;
+
+    int index = row * p->columnCount + column;
+    p->colors.remove(index);
+    p->luminances.remove(index);
+    p->prepared.clear();
+    p->updateLayout(index, p->colors.size());
+    p->updateBolder(index, p->colors.size());
+    emit colorsChanged();
+}
+
+void ColorPalette::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    p->colorCorrection = colorCorrection;
+    for (int i = 0; i < p->layout->count(); ++i) {
+        auto btn = qobject_cast<ColorButton*>(p->layout->itemAt(i)->widget());
+        btn->setColorCorrection(colorCorrection);
+    }
+}
+
+QColor ColorPalette::colorAt(int row, int column) const
+{
+    if (column >= p->columnCount) {
+        return QColor();
+    }
+    int index = row * p->columnCount + column;
+    if (index >= p->colors.size()) {
+        return QColor();
+    }
+    return p->colors[index];
+}
+
+QVector<QColor> ColorPalette::colors() const
+{
+    return p->colors;
+}
+
+int ColorPalette::nearestColor(const QColor& color, colordiff::Metric metric, float* distance) const
+{
+    const auto& prepared = p->preparedColors(metric);
+    return colordiff::nearest(metric, colordiff::prepare(metric, color), prepared.constData(), prepared.size(), distance);
+}
+
+QVector<QPair<int, int>> ColorPalette::duplicateColors(float threshold, colordiff::Metric metric) const
+{
+    const auto& prepared = p->preparedColors(metric);
+    return colordiff::duplicates(metric, prepared.constData(), prepared.size(), threshold);
+}
+
+QVector<int> ColorPalette::contrastingColors(float luminance, float minRatio) const
+{
+    // the ratio is reached by colors at least this much lighter or darker
+    const float lighter = minRatio * (luminance + 0.05f) - 0.05f;
+    const float darker = (luminance + 0.05f) / minRatio - 0.05f;
+    QVector<int> indexes;
+    const float* luminances = p->luminances.constData();
+    for (int i = 0; i < p->luminances.size(); ++i) {
+        if (luminances[i] >= lighter || luminances[i] <= darker) {
+            indexes.append(i);
+        }
+    }
+    return indexes;
+}
+
+int ColorPalette::generateColors(const palettegen::Constraints& constraints)
+{
+    auto colors = palettegen::generate(constraints, p->colors);
+    for (const auto& color : colors) {
+        addColor(color);
+    }
+    return colors.size();
+}
+
+void ColorPalette::dragEnterEvent(QDragEnterEvent* e)
+{
+    if (qvariant_cast<QColor>(e->mimeData()->colorData()).isValid())
+        e->accept();
+    else
+        e->ignore();
+}
+
+void ColorPalette::dropEvent(QDropEvent* e)
+{
+    auto color = qvariant_cast<QColor>(e->mimeData()->colorData());
+    if (color.isValid()) {
+        addColor(color);
+        e->accept();
+    }
+    else {
+        e->ignore();
+    }
+}
+
+//--------------------------------------------- contrast panel ------------------------------------------------------
+class ContrastPanel::Private
+{
+public:
+    struct Level
+    {
+        const char* name;
+        float ratio;
+        QVector<int> indexes;
+    };
+
+    ColorPalette* colorPalette;
+    ColorCorrectionPtr colorCorrection;
+    QColor current;
+    Level levels[3] = {{"AAA", 7.0f, {}}, {"AA", 4.5f, {}}, {"AA large", 3.0f, {}}};
+
+    // one luminance for the current color, the palette compares it against its cache
+    void updateLevels()
+    {
+        float luminance = contrast::luminance(current);
+        for (auto& level : levels) {
+            level.indexes = colorPalette->contrastingColors(luminance, level.ratio);
+        }
+    }
+};
+
+ContrastPanel::ContrastPanel(ColorPalette* palette, QWidget* parent)
+    : QWidget(parent)
+    , p(new Private)
+{
+    p->colorPalette = palette;
+    connect(palette, &ColorPalette::colorsChanged, this, [this]() {
+        p->updateLevels();
+        update();
+    });
+}
+
+ContrastPanel::~ContrastPanel() = default;
+
+void ContrastPanel::setCurrentColor(const QColor& color)
+{
+    p->current = color;
+    p->updateLevels();
+    update();
+}
+
+void ContrastPanel::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    update();
+}
+
+QSize ContrastPanel::sizeHint() const
+{
+    return QSize(DPI(200), 3 * (DPI(14) + 2));
+}
+
+void ContrastPanel::paintEvent(QPaintEvent* e)
+{
+    QPainter painter(this);
+    const int cell = DPI(14);
+    const int labelWidth = DPI(70);
+    const auto colors = p->colorPalette->colors();
+    QColor text = p->current;
+    if (p->colorCorrection) p->colorCorrection->correct(text);
+
+    for (int row = 0; row < 3; ++row) {
+        const auto& level = p->levels[row];
+        int y = row * (cell + 2);
+        painter.setPen(palette().color(QPalette::WindowText));
+        painter.drawText(QRect(0, y, labelWidth, cell), Qt::AlignVCenter | Qt::AlignLeft,
+                         QString("%1 (%2)").arg(level.name).arg(level.indexes.size()));
+        // each swatch as background with the current color as text
+        int x = labelWidth;
+        for (int index : level.indexes) {
+            if (x + cell > width()) break;
+            QColor swatch = colors[index];
+            if (p->colorCorrection) p->colorCorrection->correct(swatch);
+            fillSwatch(painter, QRect(x, y, cell, cell), swatch);
+            painter.setPen(text);
+            painter.drawText(QRect(x, y, cell, cell), Qt::AlignCenter, "a");
+            x += cell + 1;
+        }
+    }
+}
+
+//--------------------------------------------- tonal ramp view ------------------------------------------------------
+class TonalRampView::Private
+{
+public:
+    ColorPalette* colorPalette;
+    ColorCorrectionPtr colorCorrection;
+    tonalramp::Scale scale;
+    QColor current = Qt::white;
+    // gamut mapped OKLCH, the current ramp first, the palette ramps only change with the palette
+    std::vector<colorspace::Vec3> ramps;
+    // one pixel per step, corrected once and drawn scaled
+    QImage image;
+    bool imageDirty = true;
+
+    int stepCount() const { return scale.steps.size(); }
+
+    int rampCount() const { return stepCount() ? int(ramps.size()) / stepCount() : 0; }
+
+    void updateCurrent()
+    {
+        if (ramps.size() < size_t(stepCount())) ramps.resize(stepCount());
+        colorspace::Vec3 rgb = {float(current.redF()), float(current.greenF()), float(current.blueF())};
+        tonalramp::generate(scale, &rgb, 1, ramps.data());
+        imageDirty = true;
+    }
+
+    void updatePalette()
+    {
+        const auto colors = colorPalette->colors();
+        std::vector<colorspace::Vec3> rgb(colors.size());
+        for (int i = 0; i < colors.size(); ++i) {
+            rgb[i] = {float(colors[i].redF()), float(colors[i].greenF()), float(colors[i].blueF())};
+        }
+        ramps.resize((colors.size() + 1) * stepCount());
+        tonalramp::generate(scale, rgb.data(), colors.size(), ramps.data() + stepCount());
+        imageDirty = true;
+    }
+
+    const QImage& displayImage()
+    {
+        if (imageDirty) {
+            image = colorspace::toImage(colorspace::Space::OKLCH, ramps.data(), QSize(stepCount(), rampCount()));
+            if (colorCorrection) colorCorrection->correct(image);
+            imageDirty = false;
+        }
+        return image;
+    }
+};
+
+TonalRampView::TonalRampView(ColorPalette* palette, QWidget* parent)
+    : QWidget(parent)
+    , p(new Private)
+{
+    p->colorPalette = palette;
+    p->updatePalette();
+    p->updateCurrent();
+    connect(palette, &ColorPalette::colorsChanged, this, [this]() {
+        p->updatePalette();
+        p->updateCurrent();
+        updateGeometry();
+        update();
+    });
+}
+
+TonalRampView::~TonalRampView() = default;
+
+void TonalRampView::setScale(const tonalramp::Scale& scale)
+{
+    p->scale = scale;
+    p->updatePalette();
+    p->updateCurrent();
+    updateGeometry();
+    update();
+}
+
+tonalramp::Scale TonalRampView::scale() const
+{
+    return p->scale;
+}
+
+void TonalRampView::setCurrentColor(const QColor& color)
+{
+    if (color == p->current) return;
+
+    // palette ramps are kept, a drag tick only regenerates one ramp
+    p->current = color;
+    p->updateCurrent();
+    update();
+}
+
+void TonalRampView::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->imageDirty = true;
+    update();
+}
+
+QVector<QColor> TonalRampView::colors() const
+{
+    std::vector<colorspace::Vec3> rgb(p->ramps.size());
+    colorspace::toSrgb(colorspace::Space::OKLCH, p->ramps.data(), rgb.data(), rgb.size());
+    QVector<QColor> colors(rgb.size());
+    for (size_t i = 0; i < rgb.size(); ++i) {
+        colors[i] = QColor::fromRgbF(qBound(0.0f, rgb[i].x, 1.0f), qBound(0.0f, rgb[i].y, 1.0f), qBound(0.0f, rgb[i].z, 1.0f));
+    }
+    return colors;
+}
+
+int TonalRampView::rampCount() const
+{
+    return p->rampCount();
+}
+
+QSize TonalRampView::sizeHint() const
+{
+    return QSize(p->stepCount() * DPI(20), std::min(p->rampCount() * DPI(12), DPI(200)));
+}
+
+void TonalRampView::paintEvent(QPaintEvent* e)
+{
+    if (p->rampCount() == 0) return;
+
+    QPainter painter(this);
+    // nearest scaling keeps the cells sharp
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter.drawImage(rect(), p->displayImage());
+    // the current ramp is set apart from the palette ones
+    int rowHeight = height() / p->rampCount();
+    painter.setPen(palette().color(QPalette::Window));
+    painter.drawLine(0, rowHeight, width(), rowHeight);
+}
+
+void TonalRampView::mousePressEvent(QMouseEvent* e)
+{
+    if (p->rampCount() == 0 || !rect().contains(e->pos())) return;
+
+    int step = std::min(e->pos().x() * p->stepCount() / width(), p->stepCount() - 1);
+    int ramp = std::min(e->pos().y() * p->rampCount() / height(), p->rampCount() - 1);
+    auto rgb = colorspace::toSrgb(colorspace::Space::OKLCH, p->ramps[ramp * p->stepCount() + step]);
+    emit colorClicked(QColor::fromRgbF(qBound(0.0f, rgb.x, 1.0f), qBound(0.0f, rgb.y, 1.0f), qBound(0.0f, rgb.z, 1.0f)));
+}
+
+//--------------------------------------------- colormap builder ------------------------------------------------------
+namespace
+{
+// LUT on top, the difference between neighbouring entries below
+class ColormapPlot : public QWidget
+{
+public:
+    explicit ColormapPlot(QWidget* parent = nullptr)
+        : QWidget(parent)
+    {
+        setMinimumHeight(DPI(80));
     }
 
-    std::pair<int, int> getLayoutIndex(int index) { return {index / columnCount, index % columnCount}; }
+    // takes effect with the next setLut
+    void setMetric(colordiff::Metric m)
+    {
+        metric = m;
+    }
 
-    void updateLayout(int begin, int end)
+    void setLut(const std::vector<colorspace::Vec3>& rgb, const ColorCorrectionPtr& colorCorrection)
     {
-        for (int i = begin; i < end; ++i) {
-            int row = i / columnCount;
-            int col = i % columnCount;
-            auto btn = qobject_cast<ColorButton*>(layout->itemAtPosition(row, col)->widget());
-            btn->setColor(colors[i]);
+        const int size = rgb.size();
+        lut = QImage(std::max(size, 1), 1, QImage::Format_RGB32);
+        auto line = reinterpret_cast<QRgb*>(lut.bits());
+        for (int i = 0; i < size; ++i) {
+            line[i] = qRgb(qRound(rgb[i].x * 255), qRound(rgb[i].y * 255), qRound(rgb[i].z * 255));
         }
+        if (colorCorrection) colorCorrection->correct(lut);
+
+        differences.resize(std::max(size - 1, 0));
+        colormap::uniformity(metric, rgb.data(), size, differences.data());
+        update();
     }
 
-    void updateBolder(int begin, int end)
+protected:
+    void paintEvent(QPaintEvent*) override
     {
-        int size = colors.size();
-        for (int i = begin; i < end; ++i) {
-            int row = i / columnCount;
-            int col = i % columnCount;
-            auto btn = qobject_cast<ColorButton*>(layout->itemAtPosition(row, col)->widget());
-            int bolderLeftWidth = col == 0 ? 1 : 0;
-            int bolderTopWidth = row == 0 ? 1 : 0;
-            btn->setBolderWidth(bolderTopWidth, 1, bolderLeftWidth, 1);
+        if (differences.empty()) return;
+
+        QPainter painter(this);
+        const int lutHeight = height() / 3;
+        painter.drawImage(QRect(0, 0, width(), lutHeight), lut);
+
+        // scaled by the largest step, a flat line is a uniform map
+        const float maxDifference = *std::max_element(differences.begin(), differences.end());
+        float mean = 0;
+        for (float d : differences) {
+            mean += d;
+        }
+        mean /= differences.size();
+        const QRect plot(0, lutHeight + DPI(4), width() - 1, height() - lutHeight - DPI(4) - 1);
+        const int count = differences.size();
+        // one point per pixel column, the largest step in each column so spikes stay visible
+        QPolygonF polyline;
+        for (int x = 0; x < plot.width(); ++x) {
+            int begin = x * count / plot.width();
+            int end = std::max(begin + 1, (x + 1) * count / plot.width());
+            float value = *std::max_element(differences.begin() + begin, differences.begin() + std::min(end, count));
+            polyline << QPointF(plot.left() + x, plot.bottom() - value / std::max(maxDifference, 1e-6f) * plot.height());
         }
+        painter.setPen(palette().color(QPalette::Mid));
+        painter.drawRect(plot);
+        painter.setPen(palette().color(QPalette::WindowText));
+        painter.drawPolyline(polyline);
+        painter.drawText(plot.adjusted(DPI(2), 0, 0, 0), Qt::AlignTop | Qt::AlignLeft,
+                         QString("%1%2 mean %3  max %4").arg(QChar(0x0394)).arg(metric == colordiff::Metric::OK ? "EOK" : "E00").arg(mean, 0, 'f', 3).arg(maxDifference, 0, 'f', 3));
     }
+
+private:
+    QImage lut;
+    std::vector<float> differences;
+    colordiff::Metric metric = colordiff::Metric::OK;
 };
+} // namespace
 
-ColorPalette::ColorPalette(int column, QWidget* parent)
-    : QScrollArea(parent)
-    , p(new Private(column, this))
+class ColormapBuilder::Private
 {
-    setWidgetResizable(true);
-    setAcceptDrops(true);
-}
+public:
+    ColorStrip* anchorStrip;
+    QComboBox* kindBox;
+    QComboBox* spaceBox;
+    QComboBox* sizeBox;
+    QComboBox* metricBox;
+    QPushButton* addBtn;
+    QPushButton* removeBtn;
+    QPushButton* exportBtn;
+    ColormapPlot* plot;
+    ColorCorrectionPtr colorCorrection;
+    QVector<QColor> anchors;
+    QColor current = Qt::white;
+    std::vector<colorspace::Vec3> rgb;
 
-ColorPalette::~ColorPalette() = default;
+    Private(QWidget* parent)
+    {
+        anchorStrip = new ColorStrip(parent);
+        anchorStrip->setToolTip(tr("click an anchor to edit it with the editor, click again to release it"));
+        kindBox = new QComboBox(parent);
+        kindBox->addItem(tr("sequential"), static_cast<int>(colormap::Kind::Sequential));
+        kindBox->addItem(tr("diverging"), static_cast<int>(colormap::Kind::Diverging));
+        spaceBox = new QComboBox(parent);
+        spaceBox->addItem("OKLab", static_cast<int>(colorspace::Space::OKLab));
+        spaceBox->addItem("OKLCH", static_cast<int>(colorspace::Space::OKLCH));
+        spaceBox->addItem("CIELAB", static_cast<int>(colorspace::Space::CIELab));
+        sizeBox = new QComboBox(parent);
+        sizeBox->addItem("256", 256);
+        sizeBox->addItem("4096", 4096);
+        // OK matches the resampling, a map equalized by build() plots flat in it
+        metricBox = new QComboBox(parent);
+        metricBox->addItem(QString("%1EOK").arg(QChar(0x0394)), static_cast<int>(colordiff::Metric::OK));
+        metricBox->addItem(QString("%1E00").arg(QChar(0x0394)), static_cast<int>(colordiff::Metric::CIEDE2000));
+        addBtn = new QPushButton(tr("add"), parent);
+        addBtn->setToolTip(tr("add the current color as an anchor"));
+        removeBtn = new QPushButton(tr("remove"), parent);
+        exportBtn = new QPushButton(tr("export"), parent);
+        plot = new ColormapPlot(parent);
 
-void ColorPalette::addColor(const QColor& color)
+        auto layout = new QGridLayout(parent);
+        layout->setMargin(0);
+        layout->setSpacing(2);
+        layout->addWidget(anchorStrip, 0, 0, 1, 7);
+        layout->addWidget(kindBox, 1, 0);
+        layout->addWidget(spaceBox, 1, 1);
+        layout->addWidget(sizeBox, 1, 2);
+        layout->addWidget(metricBox, 1, 3);
+        layout->addWidget(addBtn, 1, 4);
+        layout->addWidget(removeBtn, 1, 5);
+        layout->addWidget(exportBtn, 1, 6);
+        layout->addWidget(plot, 2, 0, 1, 7);
+    }
+
+    void rebuild()
+    {
+        anchorStrip->setColors(anchors);
+        rgb.resize(anchors.isEmpty() ? 0 : sizeBox->currentData().toInt());
+        colormap::build(anchors, static_cast<colormap::Kind>(kindBox->currentData().toInt()),
+                        static_cast<colorspace::Space>(spaceBox->currentData().toInt()), rgb.data(), rgb.size());
+        plot->setMetric(static_cast<colordiff::Metric>(metricBox->currentData().toInt()));
+        plot->setLut(rgb, colorCorrection);
+        removeBtn->setEnabled(!anchors.isEmpty());
+        exportBtn->setEnabled(!anchors.isEmpty());
+    }
+};
+
+ColormapBuilder::ColormapBuilder(QWidget* parent)
+    : QWidget(parent)
+    , p(new Private(this))
 {
-    int index = p->colors.size();
-    p->colors.push_back(color);
+    p->rebuild();
 
-    auto btn = new ColorButton(this);
-    btn->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Fixed);
-    btn->setToolTip(tr("Ctrl + click to remove color"));
-    btn->setColorCorrection(p->colorCorrection);
-    connect(btn, &ColorButton::colorClicked, this, [this, index](const QColor& color) {
-        if (QApplication::keyboardModifiers() == Qt::ControlModifier) {
-            auto layoutIndex = p->getLayoutIndex(index);
-            removeColor(layoutIndex.first, layoutIndex.second);
-        }
-        else {
-            emit colorClicked(color);
-        }
+    connect(p->anchorStrip, &ColorStrip::indexClicked, this, [this](int index) {
+        bool release = index == p->anchorStrip->selectedIndex();
+        p->anchorStrip->setSelectedIndex(release ? -1 : index);
+        if (!release) emit anchorSelected(p->anchors[index]);
     });
-    connect(btn, &ColorButton::colorDroped, this, [this, index](const QColor& color) {
-        // update color at index
-        p->colors[index] = color;
+    connect(p->addBtn, &QPushButton::clicked, this, [this]() {
+        p->anchors.append(p->current);
+        p->rebuild();
+        p->anchorStrip->setSelectedIndex(p->anchors.size() - 1);
     });
-
-    auto layoutIndex = p->getLayoutIndex(index);
-    p->layout->addWidget(btn, layoutIndex.first, layoutIndex.second);
-
-    p->updateLayout(index, p->colors.size());
-    p->updateBolder(index, p->colors.size());
+    connect(p->removeBtn, &QPushButton::clicked, this, [this]() {
+        // the selected anchor, or the last one
+        int index = p->anchorStrip->selectedIndex();
+        p->anchors.remove(index < 0 ? p->anchors.size() - 1 : index);
+        p->anchorStrip->setSelectedIndex(-1);
+        p->rebuild();
+    });
+    connect(p->exportBtn, &QPushButton::clicked, this, [this]() {
+        auto fileName = QFileDialog::getSaveFileName(this, tr("Export Colormap"), "colormap.cube", tr("Cube LUT (*.cube);;Text (*.txt)"));
+        if (fileName.isEmpty()) return;
+        colormap::exportLut(fileName, p->rgb.data(), p->rgb.size());
+    });
+    for (auto box : {p->kindBox, p->spaceBox, p->sizeBox, p->metricBox}) {
+        connect(box, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, [this](int) { p->rebuild(); });
+    }
 }
 
-void ColorPalette::setColor(const QColor& color, int row, int column)
-{
-    int index = row * p->columnCount + column;
-    p->colors[index] = color;
-    p->updateLayout(index, index + 1);
-}
+ColormapBuilder::~ColormapBuilder() = default;
 
-void ColorPalette::removeColor(int row, int column)
+void ColormapBuilder::setAnchors(const QVector<QColor>& anchors)
 {
-    int size = p->colors.size();
-    auto item = p->layout->takeAt(size - 1);
-    if (item->widget()) {
-        delete item->widget();
-    }
-    delete item;
-
-    int index = row * p->columnCount + column;
-    p->colors.remove(index);
-    p->updateLayout(index, p->colors.size());
-    p->updateBolder(index, p->colors.size());
+    p->anchors = anchors;
+    p->anchorStrip->setSelectedIndex(-1);
+    p->rebuild();
 }
 
-void ColorPalette::setColorCorrection(ColorCorrection* colorCorrection)
+QVector<QColor> ColormapBuilder::anchors() const
 {
-    p->colorCorrection = colorCorrection;
-    for (int i = 0; i < p->layout->count(); ++i) {
-        auto btn = qobject_cast<ColorButton*>(p->layout->itemAt(i)->widget());
-        btn->setColorCorrection(colorCorrection);
-    }
+    return p->anchors;
 }
 
-QColor ColorPalette::colorAt(int row, int column) const
+void ColormapBuilder::setCurrentColor(const QColor& color)
 {
-    if (column >= p->columnCount) {
-        return QColor();
-    }
-    int index = row * p->columnCount + column;
-    if (index >= p->colors.size()) {
-        return QColor();
-    }
-    return p->colors[index];
-}
+    p->current = color;
+    int index = p->anchorStrip->selectedIndex();
+    if (index < 0 || p->anchors[index] == color) return;
 
-QVector<QColor> ColorPalette::colors() const
-{
-    return p->colors;
+    p->anchors[index] = color;
+    p->rebuild();
 }
 
-void ColorPalette::dragEnterEvent(QDragEnterEvent* e)
+void ColormapBuilder::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
 {
-    if (qvariant_cast<QColor>(e->mimeData()->colorData()).isValid())
-        e->accept();
-    else
-        e->ignore();
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->anchorStrip->setColorCorrection(colorCorrection);
+    p->plot->setLut(p->rgb, colorCorrection);
 }
 
-void ColorPalette::dropEvent(QDropEvent* e)
+QVector<QColor> ColormapBuilder::lut() const
 {
-    auto color = qvariant_cast<QColor>(e->mimeData()->colorData());
-    if (color.isValid()) {
-        addColor(color);
-        e->accept();
-    }
-    else {
-        e->ignore();
+    QVector<QColor> colors(p->rgb.size());
+    for (size_t i = 0; i < p->rgb.size(); ++i) {
+        colors[i] = QColor::fromRgbF(p->rgb[i].x, p->rgb[i].y, p->rgb[i].z);
     }
+    return colors;
 }
 
 //--------------------------------------------- color preview -------------------------------------------------------
@@ -980,10 +4539,20 @@ class ColorPreview::Private
 public:
     ColorButton* pbtnCurrent;
     ColorButton* pbtnPrevious;
+    QLabel* differenceLabel;
+    colordiff::Metric metric = colordiff::Metric::CIEDE2000;
+    // previous color is prepared once per metric and again when a color is dropped on it, like its luminances
+    colorspace::Vec3 previous;
+    float previousLuminance;
+    float previousApcaLuminance;
+    float difference = 0;
+    float contrastRatio = 1;
+    float apcaContrast = 0;
 
     Private(const QColor& color, QWidget* parent)
         : pbtnCurrent(new ColorButton(parent))
         , pbtnPrevious(new ColorButton(parent))
+        , differenceLabel(new QLabel(parent))
     {
         // pbtnCurrent->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
         // pbtnPrevious->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
@@ -994,14 +4563,62 @@ public:
         pbtnCurrent->setColor(color);
         pbtnPrevious->setColor(color);
 
-        auto layout = new QHBoxLayout(parent);
+        differenceLabel->setAlignment(Qt::AlignRight);
+        differenceLabel->setToolTip(tr("difference, WCAG ratio and APCA Lc of current color on previous color"));
+
+        auto buttonLayout = new QHBoxLayout();
+        buttonLayout->setSpacing(0);
+        buttonLayout->setMargin(0);
+        buttonLayout->addWidget(pbtnPrevious);
+        buttonLayout->addWidget(pbtnCurrent);
+
+        auto layout = new QVBoxLayout(parent);
         layout->setSpacing(0);
         layout->setMargin(0);
-        layout->addWidget(pbtnPrevious);
-        layout->addWidget(pbtnCurrent);
+        layout->addLayout(buttonLayout);
+        layout->addWidget(differenceLabel);
+
+        previousLuminance = contrast::luminance(color);
+        previousApcaLuminance = contrast::apcaLuminance(color);
+        setMetric(metric);
     }
 
-    void setCurrent(const QColor& color) { pbtnCurrent->setColor(color); }
+    void setCurrent(const QColor& color)
+    {
+        pbtnCurrent->setColor(color);
+        updateDifference();
+    }
+
+    void previousChanged()
+    {
+        const QColor color = pbtnPrevious->color();
+        previous = colordiff::prepare(metric, color);
+        previousLuminance = contrast::luminance(color);
+        previousApcaLuminance = contrast::apcaLuminance(color);
+        updateDifference();
+    }
+
+    void setMetric(colordiff::Metric value)
+    {
+        metric = value;
+        previous = colordiff::prepare(metric, pbtnPrevious->color());
+        updateDifference();
+    }
+
+    void updateDifference()
+    {
+        static const char* names[] = {"76", "94", "00", "OK"};
+        const QColor current = pbtnCurrent->color();
+        difference = colordiff::distance(metric, previous, colordiff::prepare(metric, current));
+        contrastRatio = contrast::ratio(contrast::luminance(current), previousLuminance);
+        apcaContrast = contrast::apca(contrast::apcaLuminance(current), previousApcaLuminance);
+        differenceLabel->setText(QString("%1E%2 %3   %4:1   Lc %5")
+                                     .arg(QChar(0x0394))
+                                     .arg(names[static_cast<int>(metric)])
+                                     .arg(difference, 0, 'f', 2)
+                                     .arg(contrastRatio, 0, 'f', 2)
+                                     .arg(apcaContrast, 0, 'f', 0));
+    }
 };
 
 ColorPreview::ColorPreview(const QColor& color, QWidget* parent)
@@ -1010,6 +4627,7 @@ ColorPreview::ColorPreview(const QColor& color, QWidget* parent)
 {
     // only emit when current color changed
     connect(p->pbtnCurrent, &ColorButton::colorDroped, this, &ColorPreview::currentColorChanged);
+    connect(p->pbtnPrevious, &ColorButton::colorDroped, this, [this]() { p->previousChanged(); });
 }
 
 ColorPreview::~ColorPreview() = default;
@@ -1019,12 +4637,32 @@ void ColorPreview::setCurrentColor(const QColor& color)
     p->setCurrent(color);
 }
 
-void ColorPreview::setColorCorrection(ColorCorrection* colorCorrection)
+void ColorPreview::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
 {
     p->pbtnCurrent->setColorCorrection(colorCorrection);
     p->pbtnPrevious->setColorCorrection(colorCorrection);
 }
 
+void ColorPreview::setDifferenceMetric(colordiff::Metric metric)
+{
+    p->setMetric(metric);
+}
+
+float ColorPreview::colorDifference() const
+{
+    return p->difference;
+}
+
+float ColorPreview::contrastRatio() const
+{
+    return p->contrastRatio;
+}
+
+float ColorPreview::apcaContrast() const
+{
+    return p->apcaContrast;
+}
+
 QColor ColorPreview::currentColor() const
 {
     return p->pbtnCurrent->color();
@@ -1035,16 +4673,168 @@ QColor ColorPreview::previousColor() const
     return p->pbtnPrevious->color();
 }
 
+//--------------------------------------------- color strip -------------------------------------------------------
+class ColorStrip::Private
+{
+public:
+    QVector<QColor> colors;
+    // corrected once per change, paint only fills rects
+    QVector<QColor> showColors;
+    ColorCorrectionPtr colorCorrection;
+    QPoint pressPos;
+    int pressedIndex = -1;
+    int selectedIndex = -1;
+
+    void updateShowColors()
+    {
+        showColors = colors;
+        if (colorCorrection) {
+            for (auto& color : showColors) {
+                colorCorrection->correct(color);
+            }
+        }
+    }
+};
+
+ColorStrip::ColorStrip(QWidget* parent)
+    : QWidget(parent)
+    , p(new Private)
+{
+    setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
+}
+
+ColorStrip::~ColorStrip() = default;
+
+void ColorStrip::setColors(const QVector<QColor>& colors)
+{
+    if (colors == p->colors) return;
+
+    bool countChanged = colors.size() != p->colors.size();
+    p->colors = colors;
+    p->updateShowColors();
+    if (countChanged) {
+        p->pressedIndex = -1;
+        if (p->selectedIndex >= colors.size()) p->selectedIndex = -1;
+        updateGeometry();
+    }
+    update();
+}
+
+void ColorStrip::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->updateShowColors();
+    update();
+}
+
+QVector<QColor> ColorStrip::colors() const
+{
+    return p->colors;
+}
+
+int ColorStrip::indexAt(const QPoint& pos) const
+{
+    if (p->colors.isEmpty() || !rect().contains(pos)) return -1;
+    return std::min(pos.x() * p->colors.size() / width(), p->colors.size() - 1);
+}
+
+void ColorStrip::setSelectedIndex(int index)
+{
+    p->selectedIndex = index >= 0 && index < p->colors.size() ? index : -1;
+    update();
+}
+
+int ColorStrip::selectedIndex() const
+{
+    return p->selectedIndex;
+}
+
+QSize ColorStrip::sizeHint() const
+{
+    return QSize(std::max(1, p->colors.size()) * DPI(20) + 1, DPI(20) + 2);
+}
+
+QSize ColorStrip::minimumSizeHint() const
+{
+    return QSize(std::max(1, p->colors.size()) * DPI(4) + 1, DPI(20) + 2);
+}
+
+void ColorStrip::paintEvent(QPaintEvent* e)
+{
+    const int count = p->colors.size();
+    if (count == 0) return;
+
+    QPainter painter(this);
+    const QColor border = palette().color(QPalette::WindowText);
+    // cell edges as integer boundaries, so neighbours share one border line
+    for (int i = 0; i < count; ++i) {
+        int left = i * (width() - 1) / count;
+        int right = (i + 1) * (width() - 1) / count;
+        QRect cell(left, 0, right - left + 1, height());
+        painter.fillRect(cell, border);
+        fillSwatch(painter, cell.adjusted(1, 1, -1, -1), p->showColors[i]);
+    }
+    painter.setPen(QColor("#ffd700"));
+    painter.setBrush(Qt::NoBrush);
+    for (int index : {p->selectedIndex, p->pressedIndex}) {
+        if (index < 0) continue;
+        int left = index * (width() - 1) / count;
+        int right = (index + 1) * (width() - 1) / count;
+        painter.drawRect(left, 0, right - left, height() - 1);
+    }
+}
+
+void ColorStrip::mousePressEvent(QMouseEvent* e)
+{
+    if (e->button() != Qt::LeftButton) return;
+
+    p->pressPos = e->pos();
+    p->pressedIndex = indexAt(e->pos());
+    update();
+}
+
+void ColorStrip::mouseMoveEvent(QMouseEvent* e)
+{
+    if (!(e->buttons() & Qt::LeftButton) || p->pressedIndex < 0) return;
+    if ((p->pressPos - e->pos()).manhattanLength() <= QApplication::startDragDistance()) return;
+
+    QColor color = p->colors[p->pressedIndex];
+    p->pressedIndex = -1;
+    update();
+
+    QMimeData* mime = new QMimeData;
+    mime->setColorData(color);
+    QDrag* drg = new QDrag(this);
+    drg->setMimeData(mime);
+    drg->setPixmap(swatchPixmap(QSize(DPI(20), DPI(20)), color));
+    drg->exec(Qt::CopyAction);
+}
+
+void ColorStrip::mouseReleaseEvent(QMouseEvent* e)
+{
+    int index = p->pressedIndex;
+    p->pressedIndex = -1;
+    update();
+    if (index >= 0 && index == indexAt(e->pos())) {
+        emit colorClicked(p->colors[index]);
+        emit indexClicked(index);
+    }
+}
+
 //------------------------------------------- color combo widget ---------------------------
 class ColorComboWidget::Private
 {
 public:
     std::queue<colorcombo::ICombination*> combs;
-    QHBoxLayout* hlayout = nullptr;
+    ColorStrip* strip = nullptr;
     QPushButton* switchBtn = nullptr;
+    QPushButton* suggestBtn = nullptr;
+    QComboBox* suggestionBox = nullptr;
     JumpableSlider* factorSlider = nullptr;
     MixedSpinBox* factorSpinbox = nullptr;
-    ColorCorrection* colorCorrection = nullptr;
+    QVector<HarmonySearch::Suggestion> suggestions;
 
     Private(QWidget* parent)
     {
@@ -1052,17 +4842,38 @@ public:
         factorSlider = new JumpableSlider(Qt::Horizontal, parent);
         switchBtn = new QPushButton(tr("switch"), parent);
         switchBtn->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+        suggestBtn = new QPushButton(tr("suggest"), parent);
+        suggestBtn->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+        suggestBtn->setToolTip(tr("find combinations closest to the palette colors"));
+        suggestionBox = new QComboBox(parent);
+        suggestionBox->setEnabled(false);
         factorSpinbox->setButtonSymbols(QAbstractSpinBox::NoButtons);
 
         auto layout = new QGridLayout(parent);
         layout->setMargin(0);
-        hlayout = new QHBoxLayout();
-        hlayout->setMargin(0);
-        hlayout->setSpacing(0);
-        layout->addLayout(hlayout, 0, 0, 1, 9);
+        strip = new ColorStrip(parent);
+        layout->addWidget(strip, 0, 0, 1, 9);
         layout->addWidget(switchBtn, 0, 9, 1, 1);
         layout->addWidget(factorSpinbox, 1, 0, 1, 4);
         layout->addWidget(factorSlider, 1, 4, 1, 6);
+        layout->addWidget(suggestionBox, 2, 0, 1, 9);
+        layout->addWidget(suggestBtn, 2, 9, 1, 1);
+    }
+
+    void showCurrent()
+    {
+        auto currentComb = combs.front();
+        factorSlider->blockSignals(true);
+        factorSpinbox->blockSignals(true);
+        factorSpinbox->setDecimals(currentComb->decimals()); // need set decimals first
+        factorSlider->setRange(currentComb->min(), currentComb->max());
+        factorSpinbox->setRange(currentComb->min(), currentComb->max());
+        factorSlider->setValue(currentComb->getValue());
+        factorSpinbox->setValue(currentComb->getValue());
+        factorSlider->setEnabled(currentComb->rangeEnabled());
+        factorSpinbox->setEnabled(currentComb->rangeEnabled());
+        factorSlider->blockSignals(false);
+        factorSpinbox->blockSignals(false);
     }
 };
 
@@ -1075,6 +4886,12 @@ ColorComboWidget::ColorComboWidget(QWidget* parent)
     switchCombination();
 
     connect(p->switchBtn, &QPushButton::clicked, this, &ColorComboWidget::switchCombination);
+    connect(p->strip, &ColorStrip::colorClicked, this, &ColorComboWidget::colorClicked);
+    connect(p->suggestBtn, &QPushButton::clicked, this, &ColorComboWidget::suggestRequested);
+    connect(p->suggestionBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::activated), this, [this](int index) {
+        if (index < 0 || index >= p->suggestions.size()) return;
+        selectCombination(p->suggestions[index].combination, p->suggestions[index].value);
+    });
     connect(p->factorSpinbox, &MixedSpinBox::editingFinished, this, [this]() {
         double value = p->factorSpinbox->value();
         p->factorSlider->setValue(value);
@@ -1099,6 +4916,7 @@ void ColorComboWidget::clearCombination()
     while (!p->combs.empty()) {
         p->combs.pop();
     }
+    setSuggestions({});
     // dummy
     addCombination(new colorcombo::ICombination(this));
     switchCombination();
@@ -1109,21 +4927,53 @@ colorcombo::ICombination* ColorComboWidget::currentCombination() const
     return p->combs.front();
 }
 
-void ColorComboWidget::setColors(const QVector<QColor>& colors)
+QVector<colorcombo::ICombination*> ColorComboWidget::combinations() const
 {
-    for (int i = 0; i < colors.size(); ++i) {
-        auto btn = qobject_cast<ColorButton*>(p->hlayout->itemAt(i)->widget());
-        btn->setColor(colors[i]);
+    QVector<colorcombo::ICombination*> combinations;
+    auto combs = p->combs;
+    while (!combs.empty()) {
+        combinations.append(combs.front());
+        combs.pop();
     }
+    return combinations;
 }
 
-void ColorComboWidget::setColorCorrection(ColorCorrection* colorCorrection)
+void ColorComboWidget::selectCombination(colorcombo::ICombination* combo, double value)
 {
-    p->colorCorrection = colorCorrection;
-    for (int i = 0; i < p->hlayout->count(); ++i) {
-        auto btn = qobject_cast<ColorButton*>(p->hlayout->itemAt(i)->widget());
-        btn->setColorCorrection(colorCorrection);
+    // rotate the queue, so switch keeps its order
+    for (size_t i = 0; i < p->combs.size() && p->combs.front() != combo; ++i) {
+        p->combs.push(p->combs.front());
+        p->combs.pop();
+    }
+    if (p->combs.front() != combo) return;
+
+    combo->setValue(qBound(combo->min(), value, combo->max()));
+    p->showCurrent();
+    emit combinationChanged(combo);
+}
+
+void ColorComboWidget::setSuggestions(const QVector<HarmonySearch::Suggestion>& suggestions)
+{
+    p->suggestions = suggestions;
+    p->suggestionBox->clear();
+    for (const auto& suggestion : suggestions) {
+        QString text = suggestion.combination->name();
+        if (suggestion.combination->rangeEnabled()) {
+            text += QString(" %1").arg(suggestion.value, 0, 'f', suggestion.combination->decimals());
+        }
+        p->suggestionBox->addItem(QString("%1   %2E %3").arg(text).arg(QChar(0x0394)).arg(suggestion.distance, 0, 'f', 3));
     }
+    p->suggestionBox->setEnabled(!suggestions.isEmpty());
+}
+
+void ColorComboWidget::setColors(const QVector<QColor>& colors)
+{
+    p->strip->setColors(colors);
+}
+
+void ColorComboWidget::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    p->strip->setColorCorrection(colorCorrection);
 }
 
 void ColorComboWidget::switchCombination()
@@ -1134,43 +4984,10 @@ void ColorComboWidget::switchCombination()
     p->combs.pop();
     p->combs.push(front);
 
-    auto currentComb = p->combs.front();
+    // the strip is resized by the next setColors, switching only repaints it
+    p->showCurrent();
 
-    // clear
-    QLayoutItem* item;
-    while (item = p->hlayout->takeAt(0)) {
-        if (item->widget()) {
-            delete item->widget();
-        }
-        delete item;
-    }
-    // add
-    auto colors = currentComb->genColors(Qt::white);
-    int size = colors.size() + 1;
-    for (int i = 0; i < size; ++i) {
-        auto btn = new ColorButton(this);
-        int bolderRightWidth = i < size - 1 ? 0 : 1;
-        btn->setBolderWidth(1, 1, 1, bolderRightWidth);
-        btn->setSizePolicy(QSizePolicy::Preferred, QSizePolicy::Preferred);
-        btn->setAcceptDrops(false); // color can't be changed by drop
-        btn->setColorCorrection(p->colorCorrection);
-        connect(btn, &ColorButton::colorClicked, this, &ColorComboWidget::colorClicked);
-        p->hlayout->addWidget(btn);
-    }
-
-    p->factorSlider->blockSignals(true);
-    p->factorSpinbox->blockSignals(true);
-    p->factorSpinbox->setDecimals(currentComb->decimals()); // need set decimals first
-    p->factorSlider->setRange(currentComb->min(), currentComb->max());
-    p->factorSpinbox->setRange(currentComb->min(), currentComb->max());
-    p->factorSlider->setValue(currentComb->getValue());
-    p->factorSpinbox->setValue(currentComb->getValue());
-    p->factorSlider->setEnabled(currentComb->rangeEnabled());
-    p->factorSpinbox->setEnabled(currentComb->rangeEnabled());
-    p->factorSlider->blockSignals(false);
-    p->factorSpinbox->blockSignals(false);
-
-    emit combinationChanged(currentComb);
+    emit combinationChanged(p->combs.front());
 }
 
 //------------------------------------------ color lineedit --------------------------------
@@ -1180,12 +4997,33 @@ ColorLineEdit::ColorLineEdit(QWidget* parent)
 {
     connect(this, &ColorLineEdit::editingFinished, this, [this]() {
         setText(text().toUpper());
-        emit currentColorChanged(QColor(text()));
+        emit currentColorChanged(parseColor(text()));
     });
 }
-void ColorLineEdit::setColor(const QColor& color)
+void ColorLineEdit::setColor(const QColor& color)
+{
+    setText(colorName(color));
+}
+
+QString ColorLineEdit::colorName(const QColor& color)
+{
+    QString name = color.name().toUpper();
+    if (color.alpha() < 255) {
+        name += QString("%1").arg(color.alpha(), 2, 16, QChar('0')).toUpper();
+    }
+    return name;
+}
+
+QColor ColorLineEdit::parseColor(const QString& name)
 {
-    setText(color.name().toUpper());
+    const QString text = name.trimmed();
+    if (text.size() == 9 && text.startsWith('#')) {
+        bool ok = false;
+        const uint rgba = text.mid(1).toUInt(&ok, 16);
+        if (!ok) return QColor();
+        return QColor((rgba >> 24) & 0xff, (rgba >> 16) & 0xff, (rgba >> 8) & 0xff, rgba & 0xff);
+    }
+    return QColor(text);
 }
 
 void ColorLineEdit::keyPressEvent(QKeyEvent* e)
@@ -1200,10 +5038,71 @@ void ColorLineEdit::keyPressEvent(QKeyEvent* e)
 class ColorPicker::Private
 {
 public:
+    static constexpr int tileSize = 64;
     int rectLength = 20;
     int scaleSize = 10;
     QPoint cursorPos;
     QImage fullScreenImg;
+    ColorCorrectionPtr colorCorrection;
+    // corrected tiles of fullScreenImg, only filled around the magnifier
+    QHash<quint64, QImage> correctedTiles;
+    // corrected tiles kept after release with their source at 3 bytes per pixel, valid for keptVersion
+    struct KeptTile
+    {
+        QImage source;
+        QImage corrected;
+    };
+    QHash<quint64, KeptTile> keptTiles;
+    quint64 keptVersion = 0;
+    ColorPicker::ReleasePolicy releasePolicy = ColorPicker::FreeOnRelease;
+    QTimer* keepTimer = nullptr;
+
+    static QRect tileRect(quint64 key) { return QRect(int(key >> 32) * tileSize, int(quint32(key)) * tileSize, tileSize, tileSize); }
+
+    void freeCapture()
+    {
+        fullScreenImg = QImage();
+        correctedTiles.clear();
+        keptTiles.clear();
+    }
+
+    void compactCapture()
+    {
+        // only the tiles that were corrected are kept, the screen itself is grabbed again on the next picking
+        keptTiles.clear();
+        for (auto it = correctedTiles.cbegin(); it != correctedTiles.cend(); ++it) {
+            keptTiles.insert(it.key(), {fullScreenImg.copy(tileRect(it.key())).convertToFormat(QImage::Format_RGB888), it.value()});
+        }
+        keptVersion = ColorCorrection::versionOf(colorCorrection);
+        fullScreenImg = QImage();
+        correctedTiles.clear();
+    }
+
+    // kept tiles whose source is unchanged on the new capture are reused instead of corrected again
+    void restoreTiles()
+    {
+        if (keptVersion == ColorCorrection::versionOf(colorCorrection)) {
+            for (auto it = keptTiles.cbegin(); it != keptTiles.cend(); ++it) {
+                if (fullScreenImg.copy(tileRect(it.key())).convertToFormat(QImage::Format_RGB888) == it.value().source) {
+                    correctedTiles.insert(it.key(), it.value().corrected);
+                }
+            }
+        }
+        keptTiles.clear();
+    }
+
+    qint64 memoryUsage() const
+    {
+        auto bytes = [](const QImage& image) { return qint64(image.bytesPerLine()) * image.height(); };
+        qint64 total = bytes(fullScreenImg);
+        for (const auto& tile : correctedTiles) {
+            total += bytes(tile);
+        }
+        for (const auto& tile : keptTiles) {
+            total += bytes(tile.source) + bytes(tile.corrected);
+        }
+        return total;
+    }
 
     void grabFullScreen()
     {
@@ -1211,6 +5110,45 @@ public:
         const QPixmap pixmap = QApplication::primaryScreen()->grabWindow(desktop->winId(), desktop->pos().x(), desktop->pos().y(),
                                                                          desktop->width(), desktop->height());
         fullScreenImg = pixmap.toImage();
+        correctedTiles.clear();
+    }
+
+    const QImage& getCorrectedTile(int tileX, int tileY)
+    {
+        quint64 key = (quint64(quint32(tileX)) << 32) | quint32(tileY);
+        auto it = correctedTiles.find(key);
+        if (it == correctedTiles.end()) {
+            QImage tile = fullScreenImg.copy(tileRect(key));
+            colorCorrection->correct(tile);
+            it = correctedTiles.insert(key, tile);
+        }
+        return it.value();
+    }
+
+    QImage getRegion(const QRect& rect)
+    {
+        if (!colorCorrection) {
+            return fullScreenImg.copy(rect);
+        }
+        // out of screen part keeps zero, the same as QImage::copy
+        QImage region(rect.size(), fullScreenImg.format());
+        region.fill(0);
+        QRect validRect = rect.intersected(fullScreenImg.rect());
+        if (validRect.isEmpty()) {
+            return region;
+        }
+
+        QPainter painter(&region);
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        for (int tileY = validRect.top() / tileSize; tileY <= validRect.bottom() / tileSize; ++tileY) {
+            for (int tileX = validRect.left() / tileSize; tileX <= validRect.right() / tileSize; ++tileX) {
+                QRect tileRect(tileX * tileSize, tileY * tileSize, tileSize, tileSize);
+                QRect srcRect = tileRect.intersected(validRect);
+                painter.drawImage(srcRect.topLeft() - rect.topLeft(), getCorrectedTile(tileX, tileY),
+                                  srcRect.translated(-tileRect.topLeft()));
+            }
+        }
+        return region;
     }
 
     QRect getScreenRect() const
@@ -1226,10 +5164,18 @@ public:
         return fullScreenImg.pixelColor(p);
     }
 
-    QImage getScaledImage(QPoint p) const
+    QColor getCorrectedColorAt(QPoint p)
+    {
+        if (!colorCorrection || !fullScreenImg.valid(p)) {
+            return fullScreenImg.pixelColor(p);
+        }
+        return getCorrectedTile(p.x() / tileSize, p.y() / tileSize).pixelColor(p.x() % tileSize, p.y() % tileSize);
+    }
+
+    QImage getScaledImage(QPoint p)
     {
         int rectHalfLength = rectLength / 2;
-        QImage img = fullScreenImg.copy(p.x() - rectHalfLength, p.y() - rectHalfLength, rectLength, rectLength);
+        QImage img = getRegion(QRect(p.x() - rectHalfLength, p.y() - rectHalfLength, rectLength, rectLength));
         return img.scaled(scaleSize * rectLength, scaleSize * rectLength);
     }
 
@@ -1252,6 +5198,11 @@ ColorPicker::ColorPicker(QWidget* parent)
     setWindowFlags(Qt::Window | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
     setMouseTracking(true);
     setCursor(Qt::CrossCursor);
+
+    p->keepTimer = new QTimer(this);
+    p->keepTimer->setSingleShot(true);
+    p->keepTimer->setInterval(3000);
+    connect(p->keepTimer, &QTimer::timeout, this, [this]() { p->freeCapture(); });
 }
 
 ColorPicker::~ColorPicker() = default;
@@ -1267,7 +5218,10 @@ QColor ColorPicker::grabScreenColor(QPoint p) const
 
 void ColorPicker::startColorPicking()
 {
+    // always a fresh capture, kept tiles only save correcting the parts of the screen that didn't change
+    p->keepTimer->stop();
     p->grabFullScreen();
+    p->restoreTiles();
     showFullScreen(); // show fullscreen only covers one screen
     QRect fullRect = p->getScreenRect();
     setGeometry(fullRect); // force reszie
@@ -1278,6 +5232,44 @@ void ColorPicker::startColorPicking()
 void ColorPicker::releaseColorPicking()
 {
     hide();
+    if (p->fullScreenImg.isNull()) return;
+
+    if (p->releasePolicy == KeepCompact) {
+        p->compactCapture();
+        p->keepTimer->start();
+    }
+    else {
+        p->freeCapture();
+    }
+}
+
+void ColorPicker::setReleasePolicy(ReleasePolicy policy, int keepMsec)
+{
+    p->releasePolicy = policy;
+    p->keepTimer->setInterval(keepMsec);
+    if (policy == FreeOnRelease && !isVisible()) {
+        p->keepTimer->stop();
+        p->freeCapture();
+    }
+}
+
+ColorPicker::ReleasePolicy ColorPicker::releasePolicy() const
+{
+    return p->releasePolicy;
+}
+
+qint64 ColorPicker::memoryUsage() const
+{
+    return p->memoryUsage();
+}
+
+void ColorPicker::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    if (ColorCorrection::versionOf(colorCorrection) == ColorCorrection::versionOf(p->colorCorrection)) return;
+
+    p->colorCorrection = colorCorrection;
+    p->correctedTiles.clear();
+    update();
 }
 
 void ColorPicker::paintEvent(QPaintEvent* e)
@@ -1294,7 +5286,7 @@ void ColorPicker::paintEvent(QPaintEvent* e)
 
     // scaled img
     auto img = p->getScaledImage(p->cursorPos);
-    auto currentColor = p->getColorAt(p->cursorPos);
+    auto currentColor = p->getCorrectedColorAt(p->cursorPos);
     // calculate img pos
     int dx = 20, dy = 20;
     int x, y;
@@ -1413,21 +5405,32 @@ struct ColorEditorData
         else {
             for (int i = 0; i < count; ++i) {
                 const QVariant v = settings.value(QLatin1String("customColors/") + QString::number(i));
+                // stored with alpha, colors saved before it was kept are opaque anyway
                 if (v.isValid()) {
-                    customColor[i] = v.toUInt();
+                    customColor[i] = QColor::fromRgba(v.toUInt());
                 }
             }
         }
 
         return customColor;
     }
+    QString readDisplayProfile()
+    {
+        const QSettings settings(QSettings::UserScope, QStringLiteral("__ColorEditor_4x12"));
+        return settings.value(QLatin1String("displayProfile")).toString();
+    }
+    void writeDisplayProfile(const QString& fileName)
+    {
+        QSettings settings(QSettings::UserScope, QStringLiteral("__ColorEditor_4x12"));
+        settings.setValue(QLatin1String("displayProfile"), fileName);
+    }
     void writeSettings(const QVector<QColor>& colors)
     {
         QSettings settings(QSettings::UserScope, QStringLiteral("__ColorEditor_4x12"));
         int count = colors.size();
         settings.setValue(QLatin1String("customCount"), count);
         for (int i = 0; i < count; ++i) {
-            settings.setValue(QLatin1String("customColors/") + QString::number(i), colors[i].rgb());
+            settings.setValue(QLatin1String("customColors/") + QString::number(i), colors[i].rgba());
         }
     }
 };
@@ -1437,14 +5440,18 @@ class ColorEditor::Private
 {
 public:
     ColorWheel* wheel;
-    QCheckBox* showInSRGB;
+    QComboBox* displayMode;
+    QComboBox* simulationMode;
     ColorLineEdit* colorText;
     ColorPreview* preview;
     ColorPicker* picker;
     QPushButton* pickerBtn;
     ColorComboWidget* combo;
+    HarmonySearch* harmonySearch;
     QGroupBox* previewGroup;
     QGroupBox* comboGroup;
+    QGroupBox* contrastGroup;
+    ContrastPanel* contrastPanel;
     ColorPalette* palette;
     ColorSpinHSlider* rSlider;
     ColorSpinHSlider* gSlider;
@@ -1452,28 +5459,92 @@ public:
     ColorSpinHSlider* hSlider;
     ColorSpinHSlider* sSlider;
     ColorSpinHSlider* vSlider;
+    ColorSpinHSlider* aSlider;
+    QVBoxLayout* colorSliderLayout;
 
-    QColor currentColor;
+    // optional rows of a perceptual space, the sliders only exist once enabled
+    struct SpaceRows
+    {
+        explicit SpaceRows(colorspace::Space space)
+            : space(space)
+        {
+        }
+
+        colorspace::Space space;
+        QWidget* widget = nullptr;
+        ColorSpinHSlider* sliders[3];
+        // kept apart from the model, so hue and out of gamut values survive the srgb round trip
+        colorspace::Vec3 value = {0, 0, 0};
+        bool enabled = false;
+    };
+    struct SpaceRange
+    {
+        const char* name;
+        float min;
+        float max;
+    };
+    SpaceRows oklchRows{colorspace::Space::OKLCH};
+    SpaceRows labRows{colorspace::Space::CIELab};
+    // rows being edited keep their own values until the next flush
+    SpaceRows* spaceSource = nullptr;
+    colorspace::GamutMapping gamutMapping = colorspace::GamutMapping::Css4;
+    // optional tonal ramps under the sliders, created once enabled
+    QWidget* rampWidget = nullptr;
+    TonalRampView* rampView = nullptr;
+    tonalramp::Scale rampScale;
+    ColormapBuilder* colormapBuilder = nullptr;
+
+    ColorModel model;
     QColor selectedColor;
     ColorEditorData colorData;
-    std::unique_ptr<ColorCorrection> colorCorrection;
+    // access with std::atomic_load/atomic_store, it may be swapped while renderers read it
+    ColorCorrectionPtr colorCorrection;
+    ColorCorrectionPtr iccCorrection;
+    RenderPrecision precision = RenderPrecision::Int8;
+    VisionDeficiency deficiency = VisionDeficiency::None;
+    float severity = 1.0f;
+    Dither dither = Dither::None;
+    static constexpr int iccModeData = -1;
+
+    // widgets are refreshed at most once per frame, input only updates the model
+    ColorModel::Channels pendingChannels;
+    bool syncWheel = true;
+    QTimer* frameTimer;
+    QElapsedTimer frameClock;
 
     Private(const QColor& color, QDialog* parent)
     {
-        colorCorrection = std::unique_ptr<ColorCorrection>(new ColorCorrection);
+        frameTimer = new QTimer(parent);
+        frameTimer->setSingleShot(true);
         selectedColor = color;
         // left
         picker = new ColorPicker(parent);
         pickerBtn = new QPushButton(tr("pick"), parent);
         wheel = new ColorWheel(parent);
-        showInSRGB = new QCheckBox(tr("show in srgb"), parent);
+        displayMode = new QComboBox(parent);
+        displayMode->addItem(tr("no correction"), static_cast<int>(TransferKind::Linear));
+        displayMode->addItem(tr("sRGB"), static_cast<int>(TransferKind::SRGB));
+        displayMode->addItem(tr("gamma 2.2"), static_cast<int>(TransferKind::Gamma));
+        displayMode->addItem(tr("BT.1886"), static_cast<int>(TransferKind::BT1886));
+        displayMode->addItem(tr("PQ"), static_cast<int>(TransferKind::PQ));
+        displayMode->addItem(tr("HLG"), static_cast<int>(TransferKind::HLG));
+        displayMode->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+        simulationMode = new QComboBox(parent);
+        simulationMode->addItem(tr("normal vision"), static_cast<int>(VisionDeficiency::None));
+        simulationMode->addItem(tr("protan"), static_cast<int>(VisionDeficiency::Protan));
+        simulationMode->addItem(tr("deutan"), static_cast<int>(VisionDeficiency::Deutan));
+        simulationMode->addItem(tr("tritan"), static_cast<int>(VisionDeficiency::Tritan));
+        simulationMode->addItem(tr("achromatopsia"), static_cast<int>(VisionDeficiency::Achromatopsia));
+        simulationMode->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
         colorText = new ColorLineEdit(parent);
         preview = new ColorPreview(color, parent);
         combo = new ColorComboWidget(parent);
+        harmonySearch = new HarmonySearch(parent);
         previewGroup = new QGroupBox(tr("Previous/Current Colors"), parent);
         comboGroup = new QGroupBox(tr("Color Combination"), parent);
+        contrastGroup = new QGroupBox(tr("Palette Contrast"), parent);
 
-        colorText->setMaximumWidth(DPI(60));
+        colorText->setMaximumWidth(DPI(72));
         colorText->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
         pickerBtn->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
 
@@ -1489,27 +5560,35 @@ public:
         auto comboGroupLayout = new QHBoxLayout(comboGroup);
         comboGroupLayout->addWidget(combo);
 
+        // palette is created with the right side, the panel is added to this group there
+        auto contrastGroupLayout = new QHBoxLayout(contrastGroup);
+
         auto leftWidget = new QWidget(parent);
         auto leftLayout = new QGridLayout(leftWidget);
         leftLayout->setContentsMargins(0, 0, 5, 0);
         leftLayout->setSpacing(0);
         leftLayout->addWidget(wheel, 0, 0, 1, 10);
-        leftLayout->addWidget(showInSRGB, 1, 0, 1, 5, Qt::AlignLeft);
-        leftLayout->addWidget(colorText, 1, 5, 1, 5, Qt::AlignRight);
+        leftLayout->addWidget(displayMode, 1, 0, 1, 4, Qt::AlignLeft);
+        leftLayout->addWidget(simulationMode, 1, 4, 1, 3, Qt::AlignLeft);
+        leftLayout->addWidget(colorText, 1, 7, 1, 3, Qt::AlignRight);
         leftLayout->addWidget(previewGroup, 2, 0, 1, 10);
-        leftLayout->addWidget(comboGroup, 3, 0, 1, 10);
+        leftLayout->addWidget(contrastGroup, 3, 0, 1, 10);
+        leftLayout->addWidget(comboGroup, 4, 0, 1, 10);
 
         // right
         palette = new ColorPalette(colorData.colCount, parent);
+        contrastPanel = new ContrastPanel(palette, parent);
+        contrastGroupLayout->addWidget(contrastPanel);
         rSlider = new ColorSpinHSlider("R", parent);
         gSlider = new ColorSpinHSlider("G", parent);
         bSlider = new ColorSpinHSlider("B", parent);
         hSlider = new ColorSpinHSlider("H", parent);
         sSlider = new ColorSpinHSlider("S", parent);
         vSlider = new ColorSpinHSlider("V", parent);
+        aSlider = new ColorSpinHSlider("A", parent);
 
         auto colorSlider = new QWidget(parent);
-        auto colorSliderLayout = new QVBoxLayout(colorSlider);
+        colorSliderLayout = new QVBoxLayout(colorSlider);
         colorSliderLayout->setContentsMargins(5, 0, 0, 0);
         colorSliderLayout->setSpacing(2);
         colorSliderLayout->addWidget(rSlider);
@@ -1519,6 +5598,8 @@ public:
         colorSliderLayout->addWidget(hSlider);
         colorSliderLayout->addWidget(sSlider);
         colorSliderLayout->addWidget(vSlider);
+        colorSliderLayout->addSpacing(5);
+        colorSliderLayout->addWidget(aSlider);
 
         rSlider->setRange(0, 1);
         gSlider->setRange(0, 1);
@@ -1526,13 +5607,16 @@ public:
         hSlider->setRange(0, 1);
         sSlider->setRange(0, 1);
         vSlider->setRange(0, 1);
+        aSlider->setRange(0, 1);
 
-        setGradientR(color);
-        setGradientG(color);
-        setGradientB(color);
-        setGradientH(color);
-        setGradientS(color);
-        setGradientV(color);
+        model.setColor(color);
+        setGradientR();
+        setGradientG();
+        setGradientB();
+        setGradientH();
+        setGradientS();
+        setGradientV();
+        setGradientA();
 
         auto rightSplitter = new QSplitter(Qt::Vertical, parent);
         rightSplitter->addWidget(palette);
@@ -1554,7 +5638,7 @@ public:
         auto okBtn = buttons->addButton(QDialogButtonBox::Ok);
         auto cancleBtn = buttons->addButton(QDialogButtonBox::Cancel);
         connect(okBtn, &QPushButton::clicked, parent, [this, parent]() {
-            selectedColor = currentColor;
+            selectedColor = model.color();
             parent->accept();
         });
         connect(cancleBtn, &QPushButton::clicked, parent, &QDialog::reject);
@@ -1565,6 +5649,63 @@ public:
         layout->addWidget(buttons);
     }
 
+    ColorCorrectionPtr correctionForMode(int data) const
+    {
+        ColorCorrectionPtr correction = ColorCorrection::withDither(iccCorrection, dither);
+        if (data != iccModeData) {
+            // no correction still needs a profile to carry the simulation
+            auto kind = static_cast<TransferKind>(data);
+            bool needed = kind != TransferKind::Linear || deficiency != VisionDeficiency::None;
+            correction = needed ? ColorCorrection::create(kind, precision, dither) : ColorCorrectionPtr();
+        }
+        return ColorCorrection::withSimulation(correction, deficiency, severity);
+    }
+
+    void updateColorCorrection()
+    {
+        std::atomic_store(&colorCorrection, correctionForMode(displayMode->currentData().toInt()));
+        applyColorCorrection();
+    }
+
+    void setIccCorrection(const ColorCorrectionPtr& correction)
+    {
+        iccCorrection = correction;
+        QString text = tr("icc: %1").arg(QFileInfo(correction->iccFileName()).fileName());
+        int index = displayMode->findData(iccModeData);
+        if (index < 0) {
+            displayMode->addItem(text, iccModeData);
+        }
+        else {
+            displayMode->setItemText(index, text);
+        }
+    }
+
+    void applyColorCorrection()
+    {
+        auto correction = std::atomic_load(&colorCorrection);
+        wheel->setColorCorrection(correction);
+        palette->setColorCorrection(correction);
+        preview->setColorCorrection(correction);
+        combo->setColorCorrection(correction);
+        contrastPanel->setColorCorrection(correction);
+        if (rampView) rampView->setColorCorrection(correction);
+        if (colormapBuilder) colormapBuilder->setColorCorrection(correction);
+        rSlider->setColorCorrection(correction);
+        gSlider->setColorCorrection(correction);
+        bSlider->setColorCorrection(correction);
+        hSlider->setColorCorrection(correction);
+        sSlider->setColorCorrection(correction);
+        vSlider->setColorCorrection(correction);
+        aSlider->setColorCorrection(correction);
+        picker->setColorCorrection(correction);
+        for (auto rows : {&oklchRows, &labRows}) {
+            if (!rows->widget) continue;
+            for (auto slider : rows->sliders) {
+                slider->setColorCorrection(correction);
+            }
+        }
+    }
+
     void blockColorSignals(bool block)
     {
         wheel->blockSignals(block);
@@ -1578,67 +5719,352 @@ public:
         hSlider->blockSignals(block);
         sSlider->blockSignals(block);
         vSlider->blockSignals(block);
+        aSlider->blockSignals(block);
+        for (auto rows : {&oklchRows, &labRows}) {
+            if (!rows->widget) continue;
+            for (auto slider : rows->sliders) {
+                slider->blockSignals(block);
+            }
+        }
+    }
+
+    int frameInterval() const
+    {
+        qreal rate = QGuiApplication::primaryScreen()->refreshRate();
+        return rate > 0 ? qRound(1000.0 / rate) : 16;
+    }
+
+    void requestUpdate()
+    {
+        if (frameTimer->isActive()) return;
+
+        // leading edge updates immediately, the rest of a frame is coalesced into one update
+        int interval = frameInterval();
+        qint64 elapsed = frameClock.isValid() ? frameClock.elapsed() : interval;
+        if (elapsed >= interval) {
+            flush();
+        }
+        else {
+            frameTimer->start(int(interval - elapsed));
+        }
+    }
+
+    void flush()
+    {
+        frameClock.restart();
+        auto channels = pendingChannels;
+        pendingChannels = ColorModel::Channels();
+        if (!channels) return;
+
+        const QColor color = model.color();
+        blockColorSignals(true);
+        {
+            if (syncWheel) {
+                wheel->setSelectedColor(color);
+            }
+            if (channels & (ColorModel::RgbChannels | ColorModel::Alpha)) {
+                colorText->setColor(color);
+                preview->setCurrentColor(color);
+            }
+            if (channels & ColorModel::RgbChannels) {
+                contrastPanel->setCurrentColor(color);
+                if (rampView) rampView->setCurrentColor(color);
+                if (colormapBuilder) colormapBuilder->setCurrentColor(color);
+            }
+            setGradient(channels);
+            const auto& v = model.value();
+            if (channels & ColorModel::Red) rSlider->setValue(v.redF());
+            if (channels & ColorModel::Green) gSlider->setValue(v.greenF());
+            if (channels & ColorModel::Blue) bSlider->setValue(v.blueF());
+            if (channels & ColorModel::Hue) hSlider->setValue(v.hueF());
+            if (channels & ColorModel::Saturation) sSlider->setValue(v.saturationF());
+            if (channels & ColorModel::Value) vSlider->setValue(v.valueF());
+            if (channels & ColorModel::Alpha) aSlider->setValue(v.alphaF());
+            if (channels & ColorModel::RgbChannels) {
+                updateSpaceRows(oklchRows);
+                updateSpaceRows(labRows);
+            }
+        }
+        blockColorSignals(false);
+
+        syncWheel = true;
+        spaceSource = nullptr;
+    }
+
+    static const SpaceRange* spaceRanges(colorspace::Space space)
+    {
+        static const SpaceRange oklch[] = {{"L", 0, 1}, {"C", 0, 0.4f}, {"h", 0, 360}};
+        static const SpaceRange lab[] = {{"L*", 0, 100}, {"a*", -128, 127}, {"b*", -128, 127}};
+        return space == colorspace::Space::OKLCH ? oklch : lab;
+    }
+
+    void setSpaceRowsEnabled(SpaceRows& rows, bool enabled)
+    {
+        rows.enabled = enabled;
+        if (enabled && !rows.widget) {
+            createSpaceRows(rows);
+        }
+        if (rows.widget) {
+            rows.widget->setVisible(enabled);
+        }
+        if (enabled) {
+            blockColorSignals(true);
+            updateSpaceRows(rows);
+            blockColorSignals(false);
+        }
+    }
+
+    void setTonalRampsEnabled(bool enabled)
+    {
+        if (enabled && !rampWidget) {
+            createTonalRamps();
+        }
+        if (rampWidget) {
+            rampWidget->setVisible(enabled);
+        }
+    }
+
+    void setColormapBuilderEnabled(bool enabled)
+    {
+        if (enabled && !colormapBuilder) {
+            colormapBuilder = new ColormapBuilder;
+            colormapBuilder->setContentsMargins(0, 5, 0, 0);
+            colormapBuilder->setColorCorrection(std::atomic_load(&colorCorrection));
+            colormapBuilder->setCurrentColor(model.color());
+            colorSliderLayout->addWidget(colormapBuilder);
+            connect(colormapBuilder, &ColormapBuilder::anchorSelected, colormapBuilder, [this](const QColor& color) { setOpaqueColor(color); });
+        }
+        if (colormapBuilder) {
+            colormapBuilder->setVisible(enabled);
+        }
+    }
+
+    void createTonalRamps()
+    {
+        rampWidget = new QWidget;
+        rampView = new TonalRampView(palette, rampWidget);
+        rampView->setScale(rampScale);
+        rampView->setColorCorrection(std::atomic_load(&colorCorrection));
+        rampView->setCurrentColor(model.color());
+        auto addBtn = new QPushButton(tr("add to palette"), rampWidget);
+        auto exportBtn = new QPushButton(tr("export"), rampWidget);
+        exportBtn->setToolTip(tr("save all ramps as json design tokens or css custom properties"));
+
+        auto buttonLayout = new QHBoxLayout();
+        buttonLayout->setMargin(0);
+        buttonLayout->addStretch();
+        buttonLayout->addWidget(addBtn);
+        buttonLayout->addWidget(exportBtn);
+        auto layout = new QVBoxLayout(rampWidget);
+        layout->setContentsMargins(0, 5, 0, 0);
+        layout->setSpacing(2);
+        layout->addWidget(rampView);
+        layout->addLayout(buttonLayout);
+        colorSliderLayout->addWidget(rampWidget);
+
+        connect(rampView, &TonalRampView::colorClicked, rampWidget, [this](const QColor& color) { setOpaqueColor(color); });
+        connect(addBtn, &QPushButton::clicked, rampWidget, [this]() {
+            for (const auto& color : tonalramp::generate(rampScale, model.color())) {
+                palette->addColor(color);
+            }
+        });
+        connect(exportBtn, &QPushButton::clicked, rampWidget, [this]() {
+            auto fileName = QFileDialog::getSaveFileName(rampWidget, tr("Export Tonal Ramps"), "tokens.json",
+                                                         tr("Design Tokens (*.json);;CSS (*.css)"));
+            if (fileName.isEmpty()) return;
+
+            QStringList names{"current"};
+            for (int i = 1; i < rampView->rampCount(); ++i) {
+                names.append(QString("palette-%1").arg(i));
+            }
+            tonalramp::exportTokens(fileName, rampScale, names, rampView->colors());
+        });
+    }
+
+    void createSpaceRows(SpaceRows& rows)
+    {
+        const SpaceRange* ranges = spaceRanges(rows.space);
+        rows.widget = new QWidget;
+        auto layout = new QVBoxLayout(rows.widget);
+        layout->setContentsMargins(0, 5, 0, 0);
+        layout->setSpacing(2);
+        for (int i = 0; i < 3; ++i) {
+            auto slider = new ColorSpinHSlider(ranges[i].name, rows.widget);
+            slider->setRange(ranges[i].min, ranges[i].max);
+            slider->setColorCorrection(std::atomic_load(&colorCorrection));
+            layout->addWidget(slider);
+            rows.sliders[i] = slider;
+            connect(slider, &ColorSpinHSlider::valueChanged, rows.widget, [this, &rows, i](double value) { setSpaceChannel(rows, i, value); });
+        }
+        colorSliderLayout->addWidget(rows.widget);
+    }
+
+    void updateSpaceRows(SpaceRows& rows)
+    {
+        if (!rows.enabled || &rows == spaceSource) return;
+
+        const auto& v = model.value();
+        auto value = colorspace::fromSrgb(rows.space, {v.redF(), v.greenF(), v.blueF()});
+        // hue of an achromatic color is undefined, keep the previous one
+        if (colorspace::isPolar(rows.space) && value.y < spaceRanges(rows.space)[1].max * 1e-3f) {
+            value.z = rows.value.z;
+        }
+        rows.value = value;
+        for (int i = 0; i < 3; ++i) {
+            rows.sliders[i]->setValue(value[i]);
+        }
+        setSpaceGradients(rows);
+    }
+
+    void setSpaceChannel(SpaceRows& rows, int index, float value)
+    {
+        rows.value[index] = value;
+        setSpaceGradients(rows);
+        // the row keeps what the user set, the model and the wheel get the color mapped into srgb
+        auto rgb = colorspace::toSrgb(rows.space, colorspace::mapToGamut(rows.space, rows.value, gamutMapping));
+        spaceSource = &rows;
+        model.setRgbF(rgb.x, rgb.y, rgb.z);
+        if (!pendingChannels) {
+            spaceSource = nullptr;
+        }
+    }
+
+    // the other channels are fixed, each gradient is sampled through the engine in one batch
+    void setSpaceGradients(const SpaceRows& rows)
+    {
+        static const int stopCount = 32;
+        const SpaceRange* ranges = spaceRanges(rows.space);
+        colorspace::Vec3 colors[3 * stopCount];
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < stopCount; ++j) {
+                colorspace::Vec3 color = rows.value;
+                color[i] = ranges[i].min + (ranges[i].max - ranges[i].min) * j / (stopCount - 1);
+                colors[i * stopCount + j] = color;
+            }
+        }
+        colorspace::Vec3 rgb[3 * stopCount];
+        colorspace::toSrgb(rows.space, colors, rgb, 3 * stopCount);
+        for (int i = 0; i < 3; ++i) {
+            QVector<QPair<double, double>> outOfGamut;
+            const double half = 0.5 / (stopCount - 1);
+            for (int j = 0; j < stopCount; ++j) {
+                const auto& c = rgb[i * stopCount + j];
+                double pos = 1.0 * j / (stopCount - 1);
+                // encoded channels, a small tolerance for rounding of the round trip
+                const float e = 1e-3f;
+                if (c.x >= -e && c.x <= 1 + e && c.y >= -e && c.y <= 1 + e && c.z >= -e && c.z <= 1 + e) continue;
+                double from = std::max(0.0, pos - half);
+                double to = std::min(1.0, pos + half);
+                if (!outOfGamut.isEmpty() && outOfGamut.last().second >= from) {
+                    outOfGamut.last().second = to;
+                }
+                else {
+                    outOfGamut.append({from, to});
+                }
+            }
+            // the strip itself is sampled per pixel, the samples above only locate the out of gamut parts
+            const colorspace::Space space = rows.space;
+            const colorspace::Vec3 value = rows.value;
+            const float low = ranges[i].min;
+            const float high = ranges[i].max;
+            rows.sliders[i]->setChannelFunction([space, value, i, low, high](const float* positions, int count, colorspace::Vec3* out) {
+                for (int j = 0; j < count; ++j) {
+                    out[j] = value;
+                    out[j][i] = low + (high - low) * positions[j];
+                }
+                colorspace::toSrgb(space, out, out, count);
+            });
+            rows.sliders[i]->setOutOfGamut(outOfGamut);
+        }
     }
 
-    void setGradient(const QColor& color)
+    void setGradient(ColorModel::Channels channels)
     {
-        bool rChanged = color.red() != currentColor.red();
-        bool gChanged = color.green() != currentColor.green();
-        bool bChanged = color.blue() != currentColor.blue();
-        bool hChanged = color.hsvHue() != currentColor.hsvHue();
-        bool sChanged = color.hsvSaturation() != currentColor.hsvSaturation();
-        bool vChanged = color.value() != currentColor.value();
+        bool rChanged = channels & ColorModel::Red;
+        bool gChanged = channels & ColorModel::Green;
+        bool bChanged = channels & ColorModel::Blue;
+        bool hChanged = channels & ColorModel::Hue;
+        bool sChanged = channels & ColorModel::Saturation;
+        bool vChanged = channels & ColorModel::Value;
 
         if (gChanged || bChanged) {
-            setGradientR(color);
+            setGradientR();
         }
         if (rChanged || bChanged) {
-            setGradientG(color);
+            setGradientG();
         }
         if (rChanged || gChanged) {
-            setGradientB(color);
+            setGradientB();
         }
         if (sChanged || vChanged) {
-            setGradientH(color);
+            setGradientH();
         }
         if (hChanged || vChanged) {
-            setGradientS(color);
+            setGradientS();
         }
         if (hChanged || sChanged) {
-            setGradientV(color);
+            setGradientV();
+        }
+        if (rChanged || gChanged || bChanged) {
+            setGradientA();
         }
     }
 
-    void setGradientR(const QColor& color)
+    // gradients read the cached channels of the model, no QColor conversion per accessor
+    void setGradientR()
     {
-        rSlider->setGradient(QColor(0, color.green(), color.blue()), QColor(255, color.green(), color.blue()));
+        const auto& v = model.value();
+        rSlider->setGradient(QColor::fromRgbF(0, v.greenF(), v.blueF()), QColor::fromRgbF(1, v.greenF(), v.blueF()));
     }
-    void setGradientG(const QColor& color)
+    void setGradientG()
     {
-        gSlider->setGradient(QColor(color.red(), 0, color.blue()), QColor(color.red(), 255, color.blue()));
+        const auto& v = model.value();
+        gSlider->setGradient(QColor::fromRgbF(v.redF(), 0, v.blueF()), QColor::fromRgbF(v.redF(), 1, v.blueF()));
     }
-    void setGradientB(const QColor& color)
+    void setGradientB()
     {
-        bSlider->setGradient(QColor(color.red(), color.green(), 0), QColor(color.red(), color.green(), 255));
+        const auto& v = model.value();
+        bSlider->setGradient(QColor::fromRgbF(v.redF(), v.greenF(), 0), QColor::fromRgbF(v.redF(), v.greenF(), 1));
     }
-    void setGradientH(const QColor& color)
+    // hsv rows are sampled from the channel, one of h/s/v follows the position
+    static GradientSlider::ChannelFunction hsvChannel(int channel, const colorcombo::HsvF& hsv)
     {
-        // hSlider is unique
-        static QGradientStops hColors(7);
-        for (int i = 0; i < hColors.size(); ++i) {
-            float f = 1.0 * i / (hColors.size() - 1);
-            hColors[i] = {f, QColor::fromHsvF(f, color.hsvSaturationF(), color.valueF())};
-        }
-        hSlider->setGradient(hColors);
+        return [channel, hsv](const float* positions, int count, colorspace::Vec3* rgb) {
+            colorcombo::HsvF color = hsv;
+            float& varying = channel == 0 ? color.h : channel == 1 ? color.s : color.v;
+            for (int i = 0; i < count; ++i) {
+                varying = positions[i];
+                rgb[i] = hsvToRgb(color);
+            }
+        };
+    }
+    void setGradientH()
+    {
+        const auto& v = model.value();
+        hSlider->setChannelFunction(hsvChannel(0, {0, float(v.saturationF()), float(v.valueF())}));
+    }
+    void setGradientS()
+    {
+        const auto& v = model.value();
+        sSlider->setChannelFunction(hsvChannel(1, {float(v.hueF()), 0, float(v.valueF())}));
+    }
+    void setGradientV()
+    {
+        const auto& v = model.value();
+        vSlider->setChannelFunction(hsvChannel(2, {float(v.hueF()), float(v.saturationF()), 0}));
     }
-    void setGradientS(const QColor& color)
+    void setGradientA()
     {
-        sSlider->setGradient(QColor::fromHsvF(color.hsvHueF(), 0, color.valueF()), QColor::fromHsvF(color.hsvHueF(), 1, color.valueF()));
+        const auto& v = model.value();
+        aSlider->setGradient(QColor::fromRgbF(v.redF(), v.greenF(), v.blueF(), 0), QColor::fromRgbF(v.redF(), v.greenF(), v.blueF(), 1));
     }
-    void setGradientV(const QColor& color)
+
+    // colors without alpha of their own, from the wheel, picker or generated sets, keep the current alpha
+    void setOpaqueColor(const QColor& color)
     {
-        vSlider->setGradient(QColor::fromHsvF(color.hsvHueF(), color.hsvSaturationF(), 0),
-                             QColor::fromHsvF(color.hsvHueF(), color.hsvSaturationF(), 1));
+        QColor withAlpha = color;
+        withAlpha.setAlphaF(model.alphaF());
+        model.setColor(withAlpha);
     }
 };
 
@@ -1668,37 +6094,31 @@ ColorEditor::ColorEditor(const QColor& initial, QWidget* parent)
     }
     // current combination
     p->wheel->setColorCombination(p->combo->currentCombination());
-    // current color
-    setCurrentColor(initial);
-    // show in srgb
-    p->showInSRGB->setChecked(true);
+    // current color, model already holds it, so refresh all widgets once
+    p->pendingChannels = ColorModel::AllChannels;
+    p->flush();
+    // display with the configured icc profile, otherwise in srgb
+    QString displayProfile = p->colorData.readDisplayProfile();
+    auto iccCorrection = displayProfile.isEmpty() ? ColorCorrectionPtr() : ColorCorrection::fromIccProfile(displayProfile);
+    if (iccCorrection) {
+        setColorCorrection(iccCorrection);
+    }
+    else {
+        p->displayMode->setCurrentIndex(p->displayMode->findData(static_cast<int>(TransferKind::SRGB)));
+    }
 }
 
 ColorEditor::~ColorEditor() = default;
 
 void ColorEditor::setCurrentColor(const QColor& color)
 {
-    p->blockColorSignals(true);
-    {
-        p->wheel->setSelectedColor(color);
-        p->colorText->setColor(color);
-        p->preview->setCurrentColor(color);
-        p->setGradient(color);
-        p->rSlider->setValue(color.redF());
-        p->gSlider->setValue(color.greenF());
-        p->bSlider->setValue(color.blueF());
-        p->hSlider->setValue(color.hsvHueF());
-        p->sSlider->setValue(color.hsvSaturationF());
-        p->vSlider->setValue(color.valueF());
-    }
-    p->blockColorSignals(false);
-
-    p->currentColor = color;
+    p->syncWheel = true;
+    p->model.setColor(color);
 }
 
 QColor ColorEditor::currentColor() const
 {
-    return p->currentColor;
+    return p->model.color();
 }
 
 QColor ColorEditor::selectedColor() const
@@ -1708,12 +6128,146 @@ QColor ColorEditor::selectedColor() const
 
 void ColorEditor::setColorCombinations(const QVector<colorcombo::ICombination*> combinations)
 {
+    p->harmonySearch->cancel();
     p->combo->clearCombination();
     for (const auto& combination : combinations) {
         p->combo->addCombination(combination);
     }
 }
 
+ColorModel* ColorEditor::colorModel() const
+{
+    return &p->model;
+}
+
+void ColorEditor::setColorCorrection(const ColorCorrectionPtr& colorCorrection)
+{
+    std::atomic_store(&p->colorCorrection, colorCorrection);
+    int data = static_cast<int>(colorCorrection ? colorCorrection->kind() : TransferKind::Linear);
+    if (colorCorrection && colorCorrection->isIccProfile()) {
+        p->setIccCorrection(colorCorrection);
+        data = p->iccModeData;
+    }
+    p->displayMode->blockSignals(true);
+    p->displayMode->setCurrentIndex(p->displayMode->findData(data));
+    p->displayMode->blockSignals(false);
+    p->applyColorCorrection();
+}
+
+bool ColorEditor::setDisplayProfile(const QString& fileName)
+{
+    auto correction = ColorCorrection::fromIccProfile(fileName, p->precision);
+    if (!correction) return false;
+
+    p->colorData.writeDisplayProfile(fileName);
+    setColorCorrection(correction);
+    if (p->deficiency != VisionDeficiency::None) {
+        p->updateColorCorrection();
+    }
+    return true;
+}
+
+void ColorEditor::setRenderPrecision(RenderPrecision precision)
+{
+    if (precision == p->precision) return;
+
+    p->precision = precision;
+    if (p->iccCorrection) {
+        auto correction = ColorCorrection::fromIccProfile(p->iccCorrection->iccFileName(), precision);
+        if (correction) p->iccCorrection = correction;
+    }
+    p->updateColorCorrection();
+}
+
+RenderPrecision ColorEditor::renderPrecision() const
+{
+    return p->precision;
+}
+
+void ColorEditor::setVisionSimulation(VisionDeficiency deficiency, float severity)
+{
+    p->deficiency = deficiency;
+    p->severity = severity;
+    p->simulationMode->blockSignals(true);
+    p->simulationMode->setCurrentIndex(p->simulationMode->findData(static_cast<int>(deficiency)));
+    p->simulationMode->blockSignals(false);
+    p->updateColorCorrection();
+}
+
+VisionDeficiency ColorEditor::visionDeficiency() const
+{
+    return p->deficiency;
+}
+
+void ColorEditor::setPickerReleasePolicy(ColorPicker::ReleasePolicy policy, int keepMsec)
+{
+    p->picker->setReleasePolicy(policy, keepMsec);
+}
+
+qint64 ColorEditor::pickerMemoryUsage() const
+{
+    return p->picker->memoryUsage();
+}
+
+void ColorEditor::setDither(Dither dither)
+{
+    if (dither == p->dither) return;
+
+    p->dither = dither;
+    p->updateColorCorrection();
+}
+
+Dither ColorEditor::dither() const
+{
+    return p->dither;
+}
+
+void ColorEditor::setOklchSlidersEnabled(bool enabled)
+{
+    p->setSpaceRowsEnabled(p->oklchRows, enabled);
+}
+
+void ColorEditor::setLabSlidersEnabled(bool enabled)
+{
+    p->setSpaceRowsEnabled(p->labRows, enabled);
+}
+
+void ColorEditor::setGamutMapping(colorspace::GamutMapping mapping)
+{
+    p->gamutMapping = mapping;
+}
+
+colorspace::GamutMapping ColorEditor::gamutMapping() const
+{
+    return p->gamutMapping;
+}
+
+int ColorEditor::generatePaletteColors(const palettegen::Constraints& constraints)
+{
+    return p->palette->generateColors(constraints);
+}
+
+void ColorEditor::setTonalRampsEnabled(bool enabled)
+{
+    p->setTonalRampsEnabled(enabled);
+}
+
+void ColorEditor::setTonalRampScale(const tonalramp::Scale& scale)
+{
+    p->rampScale = scale;
+    if (p->rampView) p->rampView->setScale(scale);
+}
+
+void ColorEditor::setColormapBuilderEnabled(bool enabled)
+{
+    p->setColormapBuilderEnabled(enabled);
+}
+
+ColorCorrectionPtr ColorEditor::colorCorrection() const
+{
+    return std::atomic_load(&p->colorCorrection);
+}
+
 void ColorEditor::closeEvent(QCloseEvent* e)
 {
     // save colors on close
@@ -1731,65 +6285,60 @@ void ColorEditor::keyPressEvent(QKeyEvent* e)
 
 void ColorEditor::initSlots()
 {
+    // frame coalesced widget update
+    connect(&p->model, &ColorModel::colorChanged, this, [this](ColorModel::Channels channels) {
+        p->pendingChannels |= channels;
+        p->requestUpdate();
+    });
+    connect(p->frameTimer, &QTimer::timeout, this, [this]() { p->flush(); });
     // color correction
-    connect(p->showInSRGB, &QCheckBox::toggled, this, [this](bool checked) {
-        auto colorCorrection = checked ? p->colorCorrection.get() : nullptr;
-        p->wheel->setColorCorrection(colorCorrection);
-        p->palette->setColorCorrection(colorCorrection);
-        p->preview->setColorCorrection(colorCorrection);
-        p->combo->setColorCorrection(colorCorrection);
-        p->rSlider->setColorCorrection(colorCorrection);
-        p->gSlider->setColorCorrection(colorCorrection);
-        p->bSlider->setColorCorrection(colorCorrection);
-        p->hSlider->setColorCorrection(colorCorrection);
-        p->sSlider->setColorCorrection(colorCorrection);
-        p->vSlider->setColorCorrection(colorCorrection);
+    connect(p->displayMode, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this,
+            [this](int) { p->updateColorCorrection(); });
+    connect(p->simulationMode, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, [this](int index) {
+        p->deficiency = static_cast<VisionDeficiency>(p->simulationMode->itemData(index).toInt());
+        p->updateColorCorrection();
     });
     // picker
     connect(p->pickerBtn, &QPushButton::clicked, p->picker, &ColorPicker::startColorPicking);
-    connect(p->picker, &ColorPicker::colorSelected, this, &ColorEditor::setCurrentColor);
+    connect(p->picker, &ColorPicker::colorSelected, this, [this](const QColor& color) {
+        p->syncWheel = true;
+        p->setOpaqueColor(color);
+    });
     // color combination
     connect(p->wheel, &ColorWheel::combinationColorChanged, p->combo, &ColorComboWidget::setColors);
     connect(p->combo, &ColorComboWidget::combinationChanged, this, [this](colorcombo::ICombination* combination) {
         p->wheel->setColorCombination(combination);
         p->comboGroup->setTitle(combination->name());
     });
+    connect(p->combo, &ColorComboWidget::suggestRequested, this, [this]() {
+        p->harmonySearch->start(p->model.color(), p->palette->colors(), p->combo->combinations());
+    });
+    connect(p->harmonySearch, &HarmonySearch::suggestionsChanged, this,
+            [this]() { p->combo->setSuggestions(p->harmonySearch->suggestions()); });
     // color wheel/text/preview/combo
-    connect(p->wheel, &ColorWheel::colorSelected, this, &ColorEditor::setCurrentColor);
+    connect(p->wheel, &ColorWheel::colorSelected, this, [this](const QColor& color) {
+        p->syncWheel = true;
+        p->setOpaqueColor(color);
+    });
     connect(p->colorText, &ColorLineEdit::currentColorChanged, this, &ColorEditor::setCurrentColor);
     connect(p->preview, &ColorPreview::currentColorChanged, this, &ColorEditor::setCurrentColor);
     connect(p->palette, &ColorPalette::colorClicked, this, &ColorEditor::setCurrentColor);
     connect(p->combo, &ColorComboWidget::colorClicked, this, [this](const QColor& color) {
         // don't change wheel color
-        p->wheel->setEnabled(false);
-        setCurrentColor(color);
-        p->wheel->setEnabled(true);
+        const QColor previous = p->model.color();
+        p->syncWheel = false;
+        p->setOpaqueColor(color);
+        // no change means no flush to reset it, later edits have to move the wheel again
+        if (p->model.color() == previous) p->syncWheel = true;
     });
     // color slider
-    connect(p->rSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) {
-        auto color = QColor::fromRgbF(value, p->currentColor.greenF(), p->currentColor.blueF());
-        setCurrentColor(color);
-    });
-    connect(p->gSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) {
-        auto color = QColor::fromRgbF(p->currentColor.redF(), value, p->currentColor.blueF());
-        setCurrentColor(color);
-    });
-    connect(p->bSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) {
-        auto color = QColor::fromRgbF(p->currentColor.redF(), p->currentColor.greenF(), value);
-        setCurrentColor(color);
-    });
-    connect(p->hSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) {
-        auto color = QColor::fromHsvF(value, p->currentColor.hsvSaturationF(), p->currentColor.valueF());
-        setCurrentColor(color);
-    });
-    connect(p->sSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) {
-        auto color = QColor::fromHsvF(p->currentColor.hsvHueF(), value, p->currentColor.valueF());
-        setCurrentColor(color);
-    });
-    connect(p->vSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) {
-        auto color = QColor::fromHsvF(p->currentColor.hsvHueF(), p->currentColor.hsvSaturationF(), value);
-        setCurrentColor(color);
-    });
+    connect(p->rSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Red, value); });
+    connect(p->gSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Green, value); });
+    connect(p->bSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Blue, value); });
+    connect(p->hSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Hue, value); });
+    connect(p->sSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Saturation, value); });
+    connect(p->vSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Value, value); });
+    connect(p->aSlider, &ColorSpinHSlider::valueChanged, this, [this](double value) { p->model.setChannel(ColorModel::Alpha, value); });
 }
 
 QColor ColorEditor::getColor(const QColor& initial, QWidget* parent, const QString& title)
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <memory>
 
 #include <QDialog>
 #include <QDoubleSpinBox>
+#include <QImage>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QScrollArea>
@@ -11,16 +14,293 @@
 #include <QWidget>
 
 //------------------------------------------- color correction -----------------------------------------------
-struct ColorCorrection
+enum class TransferKind
 {
-    float gamma = 2.2f;
-    void correct(QColor& color);
-    void correct(QImage& image);
+    Linear, // no correction
+    SRGB,   // piecewise sRGB
+    Gamma,  // pure power curve, gamma 2.2
+    BT1886, // BT.1886 with zero black level, gamma 2.4
+    PQ,     // SMPTE ST 2084, 1.0 is 10000 nits
+    HLG     // BT.2100 HLG OETF
+};
+
+enum class RenderPrecision
+{
+    Int8, // render and correct 8 bit buffers, the default fast path
+    Int16 // render and correct 16 bit buffers, quantized to 8 bit with dither once at the end (needs Qt 5.12)
+};
+
+enum class VisionDeficiency
+{
+    None,
+    Protan,       // missing L cones
+    Deutan,       // missing M cones
+    Tritan,       // missing S cones
+    Achromatopsia // no color vision, luminance only
+};
+
+// applied where the corrected value is quantized to 8 bit, one threshold lookup and add per channel,
+// Int8 keeps its 8 bit buffers, the dark steps below one linear code are only dithered with Int16
+enum class Dither
+{
+    None,     // rounded, Int16 keeps its 4x4 ordered dither
+    Ordered,  // 8x8 bayer matrix
+    BlueNoise // 64x64 void and cluster tile, built once on first use
+};
+
+// immutable once created, so it can be shared by widgets and read in worker threads
+class ColorCorrection
+{
+public:
+    // one shared profile per kind, precision and dither
+    static std::shared_ptr<const ColorCorrection> create(TransferKind kind = TransferKind::SRGB,
+                                                         RenderPrecision precision = RenderPrecision::Int8,
+                                                         Dither dither = Dither::None);
+    // display profile from an icc file, linear srgb is mapped to it, nullptr if it can't be loaded (needs Qt 5.14)
+    static std::shared_ptr<const ColorCorrection> fromIccProfile(const QString& fileName,
+                                                                 RenderPrecision precision = RenderPrecision::Int8);
+    // same profile with a color vision deficiency simulated in linear rgb before encoding, severity in [0, 1]
+    static std::shared_ptr<const ColorCorrection> withSimulation(const std::shared_ptr<const ColorCorrection>& base,
+                                                                 VisionDeficiency deficiency, float severity = 1.0f);
+    // same profile quantized with dither, base is returned if it already uses it
+    static std::shared_ptr<const ColorCorrection> withDither(const std::shared_ptr<const ColorCorrection>& base, Dither dither);
+
+    // an icc profile reports SRGB, its encode/decode are only the srgb approximation
+    TransferKind kind() const;
+    RenderPrecision precision() const;
+    // format renderers should paint into before correct()
+    QImage::Format renderFormat() const;
+    bool isIccProfile() const;
+    QString iccFileName() const;
+    VisionDeficiency deficiency() const;
+    float severity() const;
+    Dither dither() const;
+    // unique per created profile, renderers compare it to know whether a buffer is stale
+    quint64 version() const;
+    // linear value to display encoded value and back
+    float encode(float linear) const;
+    float decode(float encoded) const;
+    void correct(QColor& color) const;
+    // a 16 bit image is converted to ARGB32 in the same pass
+    void correct(QImage& image) const;
+
+    static quint64 versionOf(const std::shared_ptr<const ColorCorrection>& colorCorrection);
+
+private:
+    struct Table;
+    struct Lut3D;
+    struct Simulation;
+
+    ColorCorrection(TransferKind kind, RenderPrecision precision, const Table* table, Dither dither = Dither::None);
+    QImage correct16(const QImage& image) const;
+    ColorCorrection(const ColorCorrection&) = delete;
+    ColorCorrection& operator=(const ColorCorrection&) = delete;
+
+    const TransferKind m_kind;
+    const RenderPrecision m_precision;
+    const Table* m_table;
+    const Dither m_dither;
+    const quint64 m_version;
+    std::shared_ptr<const Lut3D> m_lut;
+    std::shared_ptr<const Simulation> m_simulation;
+    QString m_iccFileName;
+};
+using ColorCorrectionPtr = std::shared_ptr<const ColorCorrection>;
+
+//------------------------------------------- color value ----------------------------------------------------
+// converts once and keeps rgb/hsv/hsl in float, hue and saturation survive achromatic colors
+class ColorValue
+{
+public:
+    ColorValue();
+    // previous is used for channels that are undefined in color, e.g. hue of gray
+    explicit ColorValue(const QColor& color, const ColorValue& previous = ColorValue());
+
+    static ColorValue fromRgbF(float r, float g, float b, const ColorValue& previous = ColorValue());
+    static ColorValue fromHsvF(float h, float s, float v, const ColorValue& previous = ColorValue());
+    static ColorValue fromHslF(float h, float s, float l, const ColorValue& previous = ColorValue());
+    static ColorValue fromAlphaF(float a, const ColorValue& previous = ColorValue());
+
+    QColor toColor() const;
+    float redF() const;
+    float greenF() const;
+    float blueF() const;
+    float hueF() const;
+    float saturationF() const;
+    float valueF() const;
+    float hslSaturationF() const;
+    float lightnessF() const;
+    float alphaF() const;
+
+private:
+    void updateFromRgb();
+    void updateFromHsv();
+    void updateFromHsl();
+
+    float m_r;
+    float m_g;
+    float m_b;
+    float m_h;
+    float m_s;
+    float m_v;
+    float m_sl;
+    float m_l;
+    float m_a;
+};
+
+//------------------------------------------- color space ----------------------------------------------------
+// perceptual spaces of srgb colors, srgb is display encoded in [0, 1] with D65 white
+namespace colorspace
+{
+enum class Space
+{
+    OKLab,  // L 0..1, a/b about -0.4..0.4
+    OKLCH,  // L 0..1, C 0..0.4, h in degrees
+    CIELab, // L* 0..100, a*/b* about -128..127
+    CIELCh  // L* 0..100, C* 0..150, h in degrees
+};
+
+// three channels of a color, r/g/b for srgb
+struct Vec3
+{
+    float x;
+    float y;
+    float z;
+
+    float& operator[](int i) { return i == 0 ? x : i == 1 ? y : z; }
+    float operator[](int i) const { return i == 0 ? x : i == 1 ? y : z; }
+};
+
+enum class GamutMapping
+{
+    Clip,         // clamp srgb channels, hue and lightness may shift
+    ReduceChroma, // keep OKLCH lightness and hue, reduce chroma to the srgb boundary
+    Css4          // CSS Color 4, reduce chroma only until clipping is within a just noticeable OKLab difference
+};
+
+bool isPolar(Space space);
+// toSrgb isn't clamped, colors outside of srgb have channels outside of [0, 1]
+Vec3 fromSrgb(Space space, const Vec3& rgb);
+Vec3 toSrgb(Space space, const Vec3& color);
+// batches are converted in blocks, large ones are split across idle threads of the global pool
+void fromSrgb(Space space, const Vec3* rgb, Vec3* out, int count);
+void toSrgb(Space space, const Vec3* colors, Vec3* rgb, int count);
+// out holds width * height colors in scanline order
+void fromImage(Space space, const QImage& image, Vec3* out);
+// colors hold width * height colors in scanline order, clamped into an ARGB32 image
+QImage toImage(Space space, const Vec3* colors, const QSize& size);
+
+bool inGamut(Space space, const Vec3& color);
+// highest OKLCH chroma inside srgb, interpolated from a boundary table built once
+float maxChroma(float lightness, float hue);
+// mapped colors stay in their space
+Vec3 mapToGamut(Space space, const Vec3& color, GamutMapping mapping);
+void mapToGamut(Space space, const Vec3* colors, Vec3* out, int count, GamutMapping mapping);
+} // namespace colorspace
+
+//------------------------------------------- color model ----------------------------------------------------
+// widget free color state, keeps rgb/hsv/hsl in float and reports which channels changed
+class ColorModel : public QObject
+{
+    Q_OBJECT
+public:
+    enum Channel
+    {
+        Red = 0x01,
+        Green = 0x02,
+        Blue = 0x04,
+        Hue = 0x08,
+        Saturation = 0x10,
+        Value = 0x20,
+        HslSaturation = 0x40,
+        Lightness = 0x80,
+        Alpha = 0x100,
+        RgbChannels = Red | Green | Blue,
+        HsvChannels = Hue | Saturation | Value,
+        HslChannels = Hue | HslSaturation | Lightness,
+        AllChannels = RgbChannels | HsvChannels | HslChannels | Alpha
+    };
+    Q_DECLARE_FLAGS(Channels, Channel)
+
+    explicit ColorModel(QObject* parent = nullptr);
+    ~ColorModel();
+
+    void setColor(const QColor& color);
+    void setValue(const ColorValue& value);
+    void setRgbF(float r, float g, float b);
+    void setHsvF(float h, float s, float v);
+    void setHslF(float h, float s, float l);
+    void setChannel(Channel channel, float value);
+    QColor color() const;
+    float channel(Channel channel) const;
+    float redF() const;
+    float greenF() const;
+    float blueF() const;
+    // hue is kept when the color becomes achromatic
+    float hueF() const;
+    float saturationF() const;
+    float valueF() const;
+    float hslSaturationF() const;
+    float lightnessF() const;
+    float alphaF() const;
+    const ColorValue& value() const;
+
+signals:
+    void colorChanged(ColorModel::Channels channels);
+
+private:
+    class Private;
+    std::unique_ptr<Private> p;
+};
+Q_DECLARE_OPERATORS_FOR_FLAGS(ColorModel::Channels)
+
+//------------------------------------------- render scheduler -----------------------------------------------
+// renders widget buffers on a worker pool, a newer job of the same owner supersedes the older ones
+class RenderScheduler
+{
+public:
+    using RenderFunc = std::function<QImage()>;
+    using ReadyFunc = std::function<void(const QImage&)>;
+
+    static RenderScheduler* instance();
+
+    // render runs in a worker thread, ready runs in owner's thread and only for the newest job
+    void submit(QObject* owner, RenderFunc render, ReadyFunc ready);
+    // drop pending results of owner, must be called before owner is destroyed
+    void cancel(QObject* owner);
+    void waitForDone();
+
+    struct Stats
+    {
+        int renderedJobs = 0;
+        int droppedJobs = 0;
+        qint64 totalNsecs = 0;
+        qint64 lastNsecs = 0;
+        // bytes of the last presented buffer, a 16 bit render also holds twice this in its intermediate buffer
+        qint64 lastBytes = 0;
+    };
+    Stats stats() const;
+    void resetStats();
+
+private:
+    RenderScheduler();
+    ~RenderScheduler();
+
+    class Private;
+    std::unique_ptr<Private> p;
 };
 
 //------------------------------------------- color combination ----------------------------------------------
 namespace colorcombo
 {
+// hsv in [0, 1], hue kept in float
+struct HsvF
+{
+    float h;
+    float s;
+    float v;
+};
+
 class ICombination : public QObject
 {
     Q_OBJECT
@@ -29,7 +309,14 @@ public:
     explicit ICombination(double min, double max, double value, int decimals, bool rangeEnabled, QObject* parent = nullptr);
     virtual ~ICombination() = default;
     virtual QString name();
-    virtual QVector<QColor> genColors(const QColor& color);
+    // colors generated per base color
+    virtual int colorCount() const;
+    // colorCount() colors per base color into caller storage, out holds count * colorCount()
+    // value is the factor to evaluate at, so searches can run it from any thread without setValue()
+    // a combination overrides this together with colorCount(), the other forms go through it
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const;
+    void genColors(const HsvF* colors, int count, HsvF* out) const;
+    QVector<QColor> genColors(const QColor& color) const;
     void setRange(double min, double max);
     void setValue(double value);
     void setDecimals(int decimals);
@@ -40,9 +327,10 @@ public:
     int decimals() const;
 
 private:
-    double m_min;
-    double m_max;
-    double m_value;
+    // read by batch genColors on search threads while the ui may change them
+    std::atomic<double> m_min;
+    std::atomic<double> m_max;
+    std::atomic<double> m_value;
     int m_decimals;
     bool m_rangeEnabled;
 };
@@ -51,43 +339,233 @@ class Complementary : public ICombination
 {
 public:
     explicit Complementary(QObject* parent = nullptr);
+    using ICombination::genColors;
     virtual QString name() override;
-    virtual QVector<QColor> genColors(const QColor& color) override;
+    virtual int colorCount() const override;
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const override;
 };
 
 class Monochromatic : public ICombination
 {
 public:
     explicit Monochromatic(QObject* parent = nullptr);
+    using ICombination::genColors;
     virtual QString name() override;
-    virtual QVector<QColor> genColors(const QColor& color) override;
+    virtual int colorCount() const override;
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const override;
 };
 
 class Analogous : public ICombination
 {
 public:
     explicit Analogous(QObject* parent = nullptr);
+    using ICombination::genColors;
     virtual QString name() override;
-    virtual QVector<QColor> genColors(const QColor& color) override;
+    virtual int colorCount() const override;
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const override;
 };
 
 class Triadic : public ICombination
 {
 public:
     explicit Triadic(QObject* parent = nullptr);
+    using ICombination::genColors;
     virtual QString name() override;
-    virtual QVector<QColor> genColors(const QColor& color) override;
+    virtual int colorCount() const override;
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const override;
 };
 
 class Tetradic : public ICombination
 {
 public:
     explicit Tetradic(QObject* parent = nullptr);
+    using ICombination::genColors;
     virtual QString name() override;
-    virtual QVector<QColor> genColors(const QColor& color) override;
+    virtual int colorCount() const override;
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const override;
+};
+
+// harmony from a declarative rule, compiled once into a flat list of per color operations
+class RuleCombination : public ICombination
+{
+public:
+    // out = in with hue offset and saturation/level scaled, each term is base + factor * parameter
+    struct Operation
+    {
+        float hue; // offset in turns of the hue circle
+        float hueFactor;
+        float saturation;
+        float saturationFactor;
+        float level; // hsv value, or hsl lightness
+        float levelFactor;
+        bool lightness;
+    };
+
+    explicit RuleCombination(const QString& name, const QVector<Operation>& operations, QObject* parent = nullptr);
+    explicit RuleCombination(const QString& name, const QVector<Operation>& operations, double min, double max, double value,
+                             int decimals, QObject* parent = nullptr);
+
+    // a rule object or an array of them, invalid rules are skipped with a warning
+    static QVector<RuleCombination*> fromJson(const QByteArray& json, QObject* parent = nullptr);
+    static QVector<RuleCombination*> fromFile(const QString& fileName, QObject* parent = nullptr);
+
+    using ICombination::genColors;
+    virtual QString name() override;
+    virtual int colorCount() const override;
+    virtual void genColors(const HsvF* colors, int count, double value, HsvF* out) const override;
+    QVector<Operation> operations() const;
+
+private:
+    QString m_name;
+    QVector<Operation> m_operations;
 };
 } // namespace colorcombo
 
+//------------------------------------------- color difference -----------------------------------------------
+namespace colordiff
+{
+enum class Metric
+{
+    CIE76,     // euclidean in CIELAB
+    CIE94,     // graphic arts weights, the first color is the reference
+    CIEDE2000, // CIEDE2000
+    OK         // euclidean in OKLab
+};
+
+// space colors have to be prepared in before they are compared
+colorspace::Space spaceOf(Metric metric);
+colorspace::Vec3 prepare(Metric metric, const QColor& color);
+QVector<colorspace::Vec3> prepare(Metric metric, const QVector<QColor>& colors);
+
+// kernels take prepared colors, large batches are split across idle threads of the global pool
+float distance(Metric metric, const colorspace::Vec3& a, const colorspace::Vec3& b);
+// 1 x count
+void distances(Metric metric, const colorspace::Vec3& color, const colorspace::Vec3* colors, float* out, int count);
+// rows x columns, out is row major
+void distances(Metric metric, const colorspace::Vec3* rows, int rowCount, const colorspace::Vec3* columns, int columnCount, float* out);
+// index of the closest color, -1 if there is none
+int nearest(Metric metric, const colorspace::Vec3& color, const colorspace::Vec3* colors, int count, float* distance = nullptr);
+// pairs of indexes, first < second, closer than threshold
+QVector<QPair<int, int>> duplicates(Metric metric, const colorspace::Vec3* colors, int count, float threshold);
+} // namespace colordiff
+
+//------------------------------------------- color contrast -------------------------------------------------
+namespace contrast
+{
+// WCAG 2.x relative luminance
+float luminance(const QColor& color);
+// WCAG 2.x contrast ratio, 1 to 21
+float ratio(float luminance1, float luminance2);
+// APCA 0.0.98G screen luminance, it is not the WCAG one
+float apcaLuminance(const QColor& color);
+// APCA Lc of text on background, positive for dark text on a light background
+float apca(float textLuminance, float backgroundLuminance);
+} // namespace contrast
+
+//------------------------------------------- palette generator ----------------------------------------------
+namespace palettegen
+{
+struct Constraints
+{
+    int count = 8;
+    // pairwise, and against the anchors
+    colordiff::Metric metric = colordiff::Metric::CIEDE2000;
+    float minDistance = 10;
+    // WCAG ratio against background, 1 accepts any color
+    QColor background = Qt::white;
+    float minContrast = 1;
+    // OKLCH hue ranges in degrees, first > second wraps over 360, empty accepts any hue
+    QVector<QPair<float, float>> hueBands;
+    // OKLCH lightness and chroma
+    float minLightness = 0;
+    float maxLightness = 1;
+    float minChroma = 0;
+    float maxChroma = 0.4f;
+    quint32 seed = 1;
+};
+
+// up to count srgb colors meeting the constraints, the same seed gives the same colors
+// anchors take part in the distance constraint but aren't returned, fewer colors are returned once there is no room left
+QVector<QColor> generate(const Constraints& constraints, const QVector<QColor>& anchors = {});
+} // namespace palettegen
+
+//------------------------------------------- tonal ramp -----------------------------------------------------
+namespace tonalramp
+{
+struct Scale
+{
+    // design token steps, the first one is the lightest
+    QVector<int> steps = {50, 100, 200, 300, 400, 500, 600, 700, 800, 900, 950};
+    // OKLab lightness of the first and the last step, the others are spaced evenly by their step number
+    float lightest = 0.97f;
+    float darkest = 0.25f;
+    colorspace::GamutMapping mapping = colorspace::GamutMapping::Css4;
+};
+
+// hue and chroma of each srgb color at the lightness of every step, mapped into srgb
+// oklch holds count * steps.size() OKLCH colors, one ramp after another
+void generate(const Scale& scale, const colorspace::Vec3* rgb, int count, colorspace::Vec3* oklch);
+QVector<QColor> generate(const Scale& scale, const QColor& color);
+// colors hold names.size() ramps, written as css custom properties for a .css file, as json design tokens otherwise,
+// translucent colors keep their alpha
+bool exportTokens(const QString& fileName, const Scale& scale, const QStringList& names, const QVector<QColor>& colors);
+} // namespace tonalramp
+
+//------------------------------------------- colormap -------------------------------------------------------
+namespace colormap
+{
+enum class Kind
+{
+    Sequential, // low to high anchor, entries evenly spaced in OKLab difference
+    Diverging   // the middle of the anchors stays at the center, each half is spaced on its own
+};
+
+// anchors evenly placed and interpolated in space, mapped into srgb and resampled to size entries
+void build(const QVector<QColor>& anchors, Kind kind, colorspace::Space space, colorspace::Vec3* rgb, int size,
+           colorspace::GamutMapping mapping = colorspace::GamutMapping::Css4);
+QVector<QColor> build(const QVector<QColor>& anchors, Kind kind, int size, colorspace::Space space = colorspace::Space::OKLab);
+// difference between neighbouring entries, out holds size - 1
+void uniformity(colordiff::Metric metric, const colorspace::Vec3* rgb, int size, float* out);
+// LUT_1D_SIZE for a .cube file, one "r g b" line of 0 to 255 values per entry otherwise
+bool exportLut(const QString& fileName, const colorspace::Vec3* rgb, int size);
+} // namespace colormap
+
+//------------------------------------------- harmony search -------------------------------------------------
+// ranks combinations and their factor values by how close the generated colors land to a palette, in OK difference
+class HarmonySearch : public QObject
+{
+    Q_OBJECT
+public:
+    struct Suggestion
+    {
+        colorcombo::ICombination* combination;
+        double value;
+        // mean distance from each generated color to its nearest palette color
+        float distance;
+    };
+
+    explicit HarmonySearch(QObject* parent = nullptr);
+    ~HarmonySearch();
+
+    // restarts, each combination is searched on the global pool at steps factor values, at most limit results are kept
+    void start(const QColor& color, const QVector<QColor>& palette, const QVector<colorcombo::ICombination*>& combinations,
+               int steps = 64, int limit = 10);
+    // sleeps until no job uses the combinations anymore, at most one search step, so they can be deleted afterwards
+    void cancel();
+    bool isRunning() const;
+    // best first, one per combination
+    QVector<Suggestion> suggestions() const;
+
+signals:
+    // after each searched combination, so results show up while the search runs
+    void suggestionsChanged();
+    void finished();
+
+private:
+    class Private;
+    std::unique_ptr<Private> p;
+};
+
 //-------------------------------------------------- color wheel --------------------------------------------------
 class ColorWheel : public QWidget
 {
@@ -98,7 +576,7 @@ public:
 
     void setColorCombination(colorcombo::ICombination* combination);
     void setSelectedColor(const QColor& color);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
     QColor getSelectedColor() const;
     QColor getColor(int x, int y) const;
 
@@ -114,7 +592,7 @@ protected:
 
 private:
     void processMouseEvent(QMouseEvent* e);
-    void drawSelector(QPainter* painter, const QColor& color, int radius);
+    void drawSelector(QPainter* painter, const ColorValue& color, int radius);
 
     class Private;
     std::unique_ptr<Private> p;
@@ -169,12 +647,30 @@ class GradientSlider : public JumpableSlider
 {
     Q_OBJECT
 public:
+    // space the stops are interpolated in, every pixel along the slider is sampled
+    enum class Interpolation
+    {
+        SRGB,      // encoded channels, like QLinearGradient
+        LinearRGB, // linear light
+        HSV,       // hue doesn't wrap, so 0 to 1 is the full circle
+        OKLab,
+        OKLCH // hue the short way around
+    };
+    // srgb channels at count positions in [0, 1], called from a render thread
+    using ChannelFunction = std::function<void(const float* positions, int count, colorspace::Vec3* rgb)>;
+
     explicit GradientSlider(QWidget* parent = nullptr);
     ~GradientSlider();
 
-    void setGradient(const QColor& startColor, const QColor& stopColor);
-    void setGradient(const QGradientStops& colors);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    // stop alpha is interpolated linearly and drawn over a checkerboard
+    void setGradient(const QColor& startColor, const QColor& stopColor, Interpolation interpolation = Interpolation::SRGB);
+    void setGradient(const QGradientStops& colors, Interpolation interpolation = Interpolation::SRGB);
+    // exact colors of each position instead of interpolated stops
+    void setChannelFunction(const ChannelFunction& function);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    // hatched parts of the gradient, from/to positions in [0, 1]
+    void setOutOfGamut(const QVector<QPair<double, double>>& ranges);
+    // stops of setGradient, or the channel function sampled at 17 evenly spaced stops
     QGradientStops gradientColor() const;
 
 protected:
@@ -193,9 +689,12 @@ public:
     explicit ColorSpinHSlider(const QString& name, QWidget* parent = nullptr);
     ~ColorSpinHSlider();
 
-    void setGradient(const QColor& startColor, const QColor& stopColor);
-    void setGradient(const QGradientStops& colors);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    void setGradient(const QColor& startColor, const QColor& stopColor,
+                     GradientSlider::Interpolation interpolation = GradientSlider::Interpolation::SRGB);
+    void setGradient(const QGradientStops& colors, GradientSlider::Interpolation interpolation = GradientSlider::Interpolation::SRGB);
+    void setChannelFunction(const GradientSlider::ChannelFunction& function);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    void setOutOfGamut(const QVector<QPair<double, double>>& ranges);
     void setValue(double value);
     void setRange(double min, double max);
     QGradientStops gradientColor() const;
@@ -218,7 +717,7 @@ public:
     ~ColorButton();
 
     void setColor(const QColor& color);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
     void setBolderWidth(int top, int bottom, int left, int right);
     QColor color() const;
 
@@ -232,6 +731,7 @@ protected:
     void dragEnterEvent(QDragEnterEvent* e) override;
     void dragLeaveEvent(QDragLeaveEvent*) override;
     void dropEvent(QDropEvent* e) override;
+    void paintEvent(QPaintEvent* e) override;
 
 private:
     class Private;
@@ -249,12 +749,20 @@ public:
     void addColor(const QColor& color);
     void setColor(const QColor& color, int row, int column);
     void removeColor(int row, int column);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
     QColor colorAt(int row, int column) const;
     QVector<QColor> colors() const;
+    // indexes are into colors(), prepared colors are cached until the palette changes
+    int nearestColor(const QColor& color, colordiff::Metric metric = colordiff::Metric::CIEDE2000, float* distance = nullptr) const;
+    QVector<QPair<int, int>> duplicateColors(float threshold, colordiff::Metric metric = colordiff::Metric::CIEDE2000) const;
+    // indexes of colors with at least minRatio WCAG contrast to luminance, compared against cached luminances
+    QVector<int> contrastingColors(float luminance, float minRatio) const;
+    // adds colors generated with the palette colors as anchors, returns how many were added
+    int generateColors(const palettegen::Constraints& constraints);
 
 signals:
     void colorClicked(const QColor& color);
+    void colorsChanged();
 
 protected:
     void dragEnterEvent(QDragEnterEvent* e) override;
@@ -265,6 +773,81 @@ private:
     std::unique_ptr<Private> p;
 };
 
+//--------------------------------------------- contrast panel ------------------------------------------------------
+// palette colors passing WCAG AAA/AA against the current color, which one is text doesn't change the ratio
+class ContrastPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ContrastPanel(ColorPalette* palette, QWidget* parent = nullptr);
+    ~ContrastPanel();
+
+    void setCurrentColor(const QColor& color);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent* e) override;
+
+private:
+    class Private;
+    std::unique_ptr<Private> p;
+};
+
+//--------------------------------------------- tonal ramp view ------------------------------------------------------
+// ramps of the current color and every palette color, painted from one cached image
+class TonalRampView : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit TonalRampView(ColorPalette* palette, QWidget* parent = nullptr);
+    ~TonalRampView();
+
+    void setScale(const tonalramp::Scale& scale);
+    tonalramp::Scale scale() const;
+    void setCurrentColor(const QColor& color);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    // the ramp of the current color first, then one per palette color
+    QVector<QColor> colors() const;
+    int rampCount() const;
+    QSize sizeHint() const override;
+
+signals:
+    void colorClicked(const QColor& color);
+
+protected:
+    void paintEvent(QPaintEvent* e) override;
+    void mousePressEvent(QMouseEvent* e) override;
+
+private:
+    class Private;
+    std::unique_ptr<Private> p;
+};
+
+//--------------------------------------------- colormap builder ------------------------------------------------------
+// anchors, LUT preview and the difference between neighbouring entries
+class ColormapBuilder : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ColormapBuilder(QWidget* parent = nullptr);
+    ~ColormapBuilder();
+
+    void setAnchors(const QVector<QColor>& anchors);
+    QVector<QColor> anchors() const;
+    // replaces the selected anchor, so editing it updates the preview live
+    void setCurrentColor(const QColor& color);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    QVector<QColor> lut() const;
+
+signals:
+    void anchorSelected(const QColor& color);
+
+private:
+    class Private;
+    std::unique_ptr<Private> p;
+};
+
 //--------------------------------------------- color preview -------------------------------------------------------
 class ColorPreview : public QWidget
 {
@@ -274,7 +857,13 @@ public:
     ~ColorPreview();
 
     void setCurrentColor(const QColor& color);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    // metric of the difference shown between previous and current color
+    void setDifferenceMetric(colordiff::Metric metric);
+    float colorDifference() const;
+    // WCAG ratio and APCA Lc of current color as text on previous color
+    float contrastRatio() const;
+    float apcaContrast() const;
     QColor currentColor() const;
     QColor previousColor() const;
 
@@ -286,6 +875,41 @@ private:
     std::unique_ptr<Private> p;
 };
 
+//--------------------------------------------- color strip -------------------------------------------------------
+// any number of colors painted in one row, cells are hit-tested instead of being widgets
+class ColorStrip : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit ColorStrip(QWidget* parent = nullptr);
+    ~ColorStrip();
+
+    void setColors(const QVector<QColor>& colors);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    QVector<QColor> colors() const;
+    // cell index under pos, -1 if none
+    int indexAt(const QPoint& pos) const;
+    // highlighted cell, -1 for none
+    void setSelectedIndex(int index);
+    int selectedIndex() const;
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+signals:
+    void colorClicked(const QColor& color);
+    void indexClicked(int index);
+
+protected:
+    void paintEvent(QPaintEvent* e) override;
+    void mousePressEvent(QMouseEvent* e) override;
+    void mouseMoveEvent(QMouseEvent* e) override;
+    void mouseReleaseEvent(QMouseEvent* e) override;
+
+private:
+    class Private;
+    std::unique_ptr<Private> p;
+};
+
 //------------------------------------------- color combo widget ---------------------------
 class ColorComboWidget : public QWidget
 {
@@ -298,12 +922,17 @@ public:
     void clearCombination();
     void switchCombination();
     void setColors(const QVector<QColor>& colors);
-    void setColorCorrection(ColorCorrection* colorCorrection);
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    // switches to combo with its factor set to value
+    void selectCombination(colorcombo::ICombination* combo, double value);
+    void setSuggestions(const QVector<HarmonySearch::Suggestion>& suggestions);
     colorcombo::ICombination* currentCombination() const;
+    QVector<colorcombo::ICombination*> combinations() const;
 
 signals:
     void colorClicked(const QColor& color);
     void combinationChanged(colorcombo::ICombination* combo);
+    void suggestRequested();
 
 private:
     class Private;
@@ -316,7 +945,11 @@ class ColorLineEdit : public QLineEdit
     Q_OBJECT
 public:
     explicit ColorLineEdit(QWidget* parent = nullptr);
+    // #RRGGBB, or #RRGGBBAA when the color isn't opaque
     void setColor(const QColor& color);
+    static QString colorName(const QColor& color);
+    // also accepts #RRGGBBAA, QColor reads 8 digits as #AARRGGBB
+    static QColor parseColor(const QString& name);
 
 signals:
     void currentColorChanged(const QColor& color);
@@ -330,12 +963,23 @@ class ColorPicker : public QWidget
 {
     Q_OBJECT
 public:
+    enum ReleasePolicy
+    {
+        FreeOnRelease, // free the screen capture when picking is released
+        KeepCompact    // keep the corrected tiles for keepMsec, the screen is grabbed again and unchanged tiles are reused
+    };
+
     explicit ColorPicker(QWidget* parent = nullptr);
     ~ColorPicker();
 
     QColor grabScreenColor(QPoint p) const;
     void startColorPicking();
     void releaseColorPicking();
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    void setReleasePolicy(ReleasePolicy policy, int keepMsec = 3000);
+    ReleasePolicy releasePolicy() const;
+    // bytes held by the screen capture and its corrected tiles
+    qint64 memoryUsage() const;
 
 signals:
     void colorSelected(const QColor& color);
@@ -368,6 +1012,36 @@ public:
     QColor selectedColor() const;
 
     void setColorCombinations(const QVector<colorcombo::ICombination*> combinations);
+    ColorModel* colorModel() const;
+    // active display profile, nullptr for no correction, swapped atomically
+    void setColorCorrection(const ColorCorrectionPtr& colorCorrection);
+    ColorCorrectionPtr colorCorrection() const;
+    // load an icc display profile and use it, the path is remembered for the next editor
+    bool setDisplayProfile(const QString& fileName);
+    void setRenderPrecision(RenderPrecision precision);
+    RenderPrecision renderPrecision() const;
+    // simulated on top of the display profile, for every rendered widget
+    void setVisionSimulation(VisionDeficiency deficiency, float severity = 1.0f);
+    VisionDeficiency visionDeficiency() const;
+    // screen capture of the picker between pickings, see ColorPicker
+    void setPickerReleasePolicy(ColorPicker::ReleasePolicy policy, int keepMsec = 3000);
+    qint64 pickerMemoryUsage() const;
+    // dither of the final quantization to 8 bit, against banding in smooth gradients
+    void setDither(Dither dither);
+    Dither dither() const;
+    // optional L/C/h and L*/a*/b* slider rows, created when first enabled
+    void setOklchSlidersEnabled(bool enabled);
+    void setLabSlidersEnabled(bool enabled);
+    // how colors set by those sliders outside of srgb are brought into it
+    void setGamutMapping(colorspace::GamutMapping mapping);
+    colorspace::GamutMapping gamutMapping() const;
+    // generated colors go into the palette, its colors are kept as anchors
+    int generatePaletteColors(const palettegen::Constraints& constraints);
+    // tint and shade ramps of the current and the palette colors, created when first enabled
+    void setTonalRampsEnabled(bool enabled);
+    // colormap anchors are picked with the editor, created when first enabled
+    void setColormapBuilderEnabled(bool enabled);
+    void setTonalRampScale(const tonalramp::Scale& scale);
 
 signals:
     void currentColorChanged(const QColor& color);